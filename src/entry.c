@@ -88,28 +88,6 @@ icon_cb (GtkEntry * entry, GtkEntryIconPosition pos, GdkEventButton * event, gpo
     }
 }
 
-static GtkTreeModel *
-create_completion_model (void)
-{
-  GtkListStore *store;
-  GtkTreeIter iter;
-  gint i = 0;
-
-  store = gtk_list_store_new (1, G_TYPE_STRING);
-
-  if (options.extra_data)
-    {
-      while (options.extra_data[i] != NULL)
-        {
-          gtk_list_store_append (store, &iter);
-          gtk_list_store_set (store, &iter, 0, options.extra_data[i], -1);
-          i++;
-        }
-    }
-
-  return GTK_TREE_MODEL (store);
-}
-
 GtkWidget *
 entry_create_widget (GtkWidget * dlg)
 {
@@ -207,17 +185,23 @@ entry_create_widget (GtkWidget * dlg)
           entry = gtk_bin_get_child (GTK_BIN (c));
           if (options.entry_data.licon)
             {
-              GdkPixbuf *pb = get_pixbuf (options.entry_data.licon, YAD_SMALL_ICON);
+              GdkPixbuf *pb = get_icon_pixbuf (options.entry_data.licon, YAD_SMALL_ICON);
 
               if (pb)
-                gtk_entry_set_icon_from_pixbuf (GTK_ENTRY (entry), GTK_ENTRY_ICON_PRIMARY, pb);
+                {
+                  gtk_entry_set_icon_from_pixbuf (GTK_ENTRY (entry), GTK_ENTRY_ICON_PRIMARY, pb);
+                  g_object_unref (pb);
+                }
             }
           if (options.entry_data.ricon)
             {
-              GdkPixbuf *pb = get_pixbuf (options.entry_data.ricon, YAD_SMALL_ICON);
+              GdkPixbuf *pb = get_icon_pixbuf (options.entry_data.ricon, YAD_SMALL_ICON);
 
               if (pb)
-                gtk_entry_set_icon_from_pixbuf (GTK_ENTRY (entry), GTK_ENTRY_ICON_SECONDARY, pb);
+                {
+                  gtk_entry_set_icon_from_pixbuf (GTK_ENTRY (entry), GTK_ENTRY_ICON_SECONDARY, pb);
+                  g_object_unref (pb);
+                }
             }
         }
       else
@@ -274,37 +258,29 @@ entry_create_widget (GtkWidget * dlg)
 
       if (options.entry_data.completion)
         {
-          GtkEntryCompletion *completion;
-          GtkTreeModel *completion_model;
-
-          completion = gtk_entry_completion_new ();
-          gtk_entry_set_completion (GTK_ENTRY (entry), completion);
-
-          completion_model = create_completion_model ();
-          gtk_entry_completion_set_model (completion, completion_model);
-          g_object_unref (completion_model);
-
-          gtk_entry_completion_set_text_column (completion, 0);
-
-          if (options.common_data.complete != YAD_COMPLETE_SIMPLE)
-            gtk_entry_completion_set_match_func (completion, check_complete, NULL, NULL);
-
-          g_object_unref (completion);
+          init_completion (entry);
+          set_completion_items (entry, options.extra_data);
         }
 
       if (options.entry_data.licon)
         {
-          GdkPixbuf *pb = get_pixbuf (options.entry_data.licon, YAD_SMALL_ICON);
+          GdkPixbuf *pb = get_icon_pixbuf (options.entry_data.licon, YAD_SMALL_ICON);
 
           if (pb)
-            gtk_entry_set_icon_from_pixbuf (GTK_ENTRY (entry), GTK_ENTRY_ICON_PRIMARY, pb);
+            {
+              gtk_entry_set_icon_from_pixbuf (GTK_ENTRY (entry), GTK_ENTRY_ICON_PRIMARY, pb);
+              g_object_unref (pb);
+            }
         }
       if (options.entry_data.ricon)
         {
-          GdkPixbuf *pb = get_pixbuf (options.entry_data.ricon, YAD_SMALL_ICON);
+          GdkPixbuf *pb = get_icon_pixbuf (options.entry_data.ricon, YAD_SMALL_ICON);
 
           if (pb)
-            gtk_entry_set_icon_from_pixbuf (GTK_ENTRY (entry), GTK_ENTRY_ICON_SECONDARY, pb);
+            {
+              gtk_entry_set_icon_from_pixbuf (GTK_ENTRY (entry), GTK_ENTRY_ICON_SECONDARY, pb);
+              g_object_unref (pb);
+            }
         }
     }
 
@@ -238,29 +238,26 @@ set_field_value (guint num, gchar * value)
 
     case YAD_FIELD_COMPLETE:
       {
-        GtkEntryCompletion *c;
-        GtkTreeModel *m;
-        GtkTreeIter it;
+        gchar **items;
         gint i = 0, def = -1;
 
-        c = gtk_entry_get_completion (GTK_ENTRY (w));
-        m = gtk_entry_completion_get_model (GTK_ENTRY_COMPLETION (c));
-        gtk_list_store_clear (GTK_LIST_STORE (m));
-
         s = g_strsplit (value, options.common_data.item_separator, -1);
+        items = g_new0 (gchar *, g_strv_length (s) + 1);
         while (s[i])
           {
-            gtk_list_store_append (GTK_LIST_STORE (m), &it);
             if (s[i][0] == '^')
               {
-                gtk_list_store_set (GTK_LIST_STORE (m), &it, 0, g_strcompress (s[i] + 1), -1);
+                items[i] = g_strcompress (s[i] + 1);
                 def = i;
               }
             else
-              gtk_list_store_set (GTK_LIST_STORE (m), &it, 0, g_strcompress (s[i]), -1);
+              items[i] = g_strcompress (s[i]);
 
             i++;
           }
+        set_completion_items (w, items);
+        g_strfreev (items);
+
         if (def >= 0)
           gtk_entry_set_text (GTK_ENTRY (w), s[def] + 1);
         else
@@ -774,20 +771,7 @@ form_create_widget (GtkWidget * dlg)
               gtk_widget_set_hexpand (e, TRUE);
 #endif
               if (fld->type == YAD_FIELD_COMPLETE)
-                {
-                  GtkEntryCompletion *c = gtk_entry_completion_new ();
-                  GtkListStore *m = gtk_list_store_new (1, G_TYPE_STRING);
-
-                  gtk_entry_set_completion (GTK_ENTRY (e), c);
-                  gtk_entry_completion_set_model (c, GTK_TREE_MODEL (m));
-                  gtk_entry_completion_set_text_column (c, 0);
-
-                  if (options.common_data.complete != YAD_COMPLETE_SIMPLE)
-                    gtk_entry_completion_set_match_func (c, check_complete, NULL, NULL);
-
-                  g_object_unref (m);
-                  g_object_unref (c);
-                }
+                init_completion (e);
 
               gtk_label_set_mnemonic_widget (GTK_LABEL (l), e);
               fields = g_slist_append (fields, e);
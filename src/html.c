@@ -285,7 +285,7 @@ handle_stdin (GIOChannel * ch, GIOCondition cond, gpointer d)
       return FALSE;
 
     case G_IO_STATUS_EOF:
-      webkit_web_view_load_string (view, inbuf->str, options.html_data.mime, options.html_data.encoding, NULL);
+      webkit_web_view_load_string (view, inbuf->str, options.html_data.mime, options.common_data.encoding, NULL);
       return FALSE;
 
     case G_IO_STATUS_AGAIN:
@@ -17,6 +17,11 @@
  * Copyright (C) 2008-2017, Victor Ananjevsky <ananasik@gmail.com>
  */
 
+#include <string.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+
 #include "yad.h"
 
 static GtkWidget *icon_view;
@@ -29,6 +34,8 @@ enum {
   COL_PIXBUF,
   COL_COMMAND,
   COL_TERM,
+  COL_MTIME,
+  COL_SIZE,
   NUM_COLS
 };
 
@@ -40,11 +47,99 @@ enum {
 typedef struct {
   gchar *name;
   gchar *comment;
-  GdkPixbuf *pixbuf;
+  gchar *icon;
+  gboolean icon_is_file;
   gchar *command;
   gboolean in_term;
 } DEntry;
 
+#define INSERT_BATCH 256
+
+enum {
+  JOB_PARSE,
+  JOB_DECODE
+};
+
+/* job for worker threads. Same structure returns results to main thread */
+typedef struct {
+  gint type;
+  gint gen;
+  gchar *filename;
+  /* parsing */
+  DEntry *ent;
+  gint64 mtime;
+  gint64 fsize;
+  /* icon decoding */
+  gchar *path;
+  gint size;
+  GdkPixbuf *pixbuf;
+} IconJob;
+
+static GThreadPool *icons_pool = NULL;
+static GAsyncQueue *results = NULL;
+static volatile gint load_gen = 0;
+static volatile gint deliver_pending = 0;
+
+static GHashTable *rows = NULL;         /* filename -> GtkTreeIter */
+static gint icon_size = 0;
+static gint pending_jobs = 0;
+
+/* on-disk cache of parsed entries. All numbers are in host byte order,
+ * strings and pixels are referenced by offsets from the start of file */
+#define CACHE_MAGIC "YADICON1"
+#define CACHE_VERSION 1
+#define CACHE_MAX_ICON 1024
+
+typedef struct {
+  gchar magic[8];
+  guint32 version;
+  guint32 n_entries;
+} CacheHeader;
+
+typedef struct {
+  gint64 mtime;
+  gint64 size;
+  guint32 filename;
+  guint32 name;
+  guint32 comment;
+  guint32 command;
+  guint32 in_term;
+  guint32 has_alpha;
+  guint32 width;
+  guint32 height;
+  guint32 rowstride;
+  guint32 pixels;
+} CacheRecord;
+
+static gchar *cache_file = NULL;
+static GMappedFile *cache_map = NULL;
+static GHashTable *cache_entries = NULL;        /* filename -> CacheRecord */
+static gboolean cache_dirty = FALSE;
+
+#define READ_BLOCK_SIZE 4096
+#define MAX_READ_BLOCKS 64
+
+static GString *in_buf = NULL;
+static GtkTreeIter in_iter;
+static gint in_column = COL_NAME;
+
+/* light-weight grid for large sets of items */
+#define GRID_PADDING 6
+#define GRID_TEXT_LINES 2
+
+static GtkAdjustment *grid_adj = NULL;
+static GtkTreeRowReference *grid_sel = NULL;
+static gint grid_cols = 1;
+static gint grid_item_w, grid_item_h;
+static guint grid_update_id = 0;
+
+#ifdef HAVE_GIO
+#define CHANGES_DELAY 200       /* ms */
+
+static GHashTable *changed_files = NULL;
+static guint changes_timeout = 0;
+#endif
+
 static void
 select_cb (GObject * obj, gpointer data)
 {
@@ -95,11 +190,7 @@ activate_cb (GtkWidget * view, GtkTreePath * path, gpointer data)
   if (!path)
     return;
 
-  if (!options.icons_data.compact)
-    model = gtk_icon_view_get_model (GTK_ICON_VIEW (view));
-  else
-    model = gtk_tree_view_get_model (GTK_TREE_VIEW (view));
-
+  model = GTK_TREE_MODEL (store);
   gtk_tree_model_get_iter (model, &iter, path);
   gtk_tree_model_get (model, &iter, COL_COMMAND, &cmd, COL_TERM, &in_term, -1);
 
@@ -118,120 +209,565 @@ activate_cb (GtkWidget * view, GtkTreePath * path, gpointer data)
     }
 }
 
+static gint
+grid_n_items ()
+{
+  return gtk_tree_model_iter_n_children (GTK_TREE_MODEL (store), NULL);
+}
+
+static void
+grid_scroll_to (gdouble value)
+{
+  gdouble max = gtk_adjustment_get_upper (grid_adj) - gtk_adjustment_get_page_size (grid_adj);
+
+  gtk_adjustment_set_value (grid_adj, CLAMP (value, 0, MAX (max, 0)));
+}
+
+/* recalculate layout. Only number of items matters, because all items have the same size */
 static gboolean
-handle_stdin (GIOChannel * channel, GIOCondition condition, gpointer data)
+grid_update (gpointer data)
 {
-  static GtkTreeIter iter;
-  static gint column_count = 1;
-  static gint row_count = 0;
-  static gboolean first_time = TRUE;
-  GtkTreeModel *model;
+  GtkAllocation alloc;
+  gint rows;
 
-  if (!options.icons_data.compact)
-    model = gtk_icon_view_get_model (GTK_ICON_VIEW (icon_view));
+  grid_update_id = 0;
+
+#if GTK_CHECK_VERSION(2,18,0)
+  gtk_widget_get_allocation (icon_view, &alloc);
+#else
+  alloc = icon_view->allocation;
+#endif
+  grid_cols = MAX (1, alloc.width / grid_item_w);
+  rows = (grid_n_items () + grid_cols - 1) / grid_cols;
+
+  gtk_adjustment_configure (grid_adj, gtk_adjustment_get_value (grid_adj), 0, rows * grid_item_h,
+                            grid_item_h / 2, alloc.height, alloc.height);
+  grid_scroll_to (gtk_adjustment_get_value (grid_adj));
+  gtk_widget_queue_draw (icon_view);
+
+  return FALSE;
+}
+
+/* model changes are coalesced to a single update */
+static void
+grid_queue_update (gpointer data)
+{
+  if (grid_update_id == 0)
+    grid_update_id = g_idle_add (grid_update, NULL);
+}
+
+static void
+grid_measure ()
+{
+  PangoContext *ctx;
+  PangoFontMetrics *metrics;
+  gint line_height;
+
+  ctx = gtk_widget_get_pango_context (icon_view);
+  metrics = pango_context_get_metrics (ctx, pango_context_get_font_description (ctx), NULL);
+  line_height = PANGO_PIXELS (pango_font_metrics_get_ascent (metrics) + pango_font_metrics_get_descent (metrics));
+  pango_font_metrics_unref (metrics);
+
+  if ((gint) options.icons_data.width > 0)
+    grid_item_w = options.icons_data.width;
   else
-    model = gtk_tree_view_get_model (GTK_TREE_VIEW (icon_view));
+    grid_item_w = 2 * icon_size + 2 * GRID_PADDING;
+  grid_item_h = icon_size + GRID_TEXT_LINES * line_height + 3 * GRID_PADDING;
+}
+
+static gint
+grid_item_at (gint x, gint y)
+{
+  gint col, idx;
+
+  if (x < 0 || y < 0)
+    return -1;
+
+  col = x / grid_item_w;
+  if (col >= grid_cols)
+    return -1;
+
+  idx = ((y + (gint) gtk_adjustment_get_value (grid_adj)) / grid_item_h) * grid_cols + col;
+  if (idx >= grid_n_items ())
+    return -1;
+
+  return idx;
+}
+
+static gint
+grid_selected ()
+{
+  GtkTreePath *path;
+  gint idx;
+
+  if (grid_sel == NULL || (path = gtk_tree_row_reference_get_path (grid_sel)) == NULL)
+    return -1;
+
+  idx = gtk_tree_path_get_indices (path)[0];
+  gtk_tree_path_free (path);
+
+  return idx;
+}
+
+static void
+grid_select (gint idx)
+{
+  GtkTreePath *path;
+  gdouble top, value, height;
+
+  if (grid_sel)
+    gtk_tree_row_reference_free (grid_sel);
+  grid_sel = NULL;
+
+  gtk_widget_queue_draw (icon_view);
+  if (idx < 0)
+    return;
+
+  path = gtk_tree_path_new_from_indices (idx, -1);
+  grid_sel = gtk_tree_row_reference_new (GTK_TREE_MODEL (store), path);
+  gtk_tree_path_free (path);
+
+  /* make selected item visible */
+  top = (idx / grid_cols) * grid_item_h;
+  value = gtk_adjustment_get_value (grid_adj);
+  height = gtk_adjustment_get_page_size (grid_adj);
+  if (top < value)
+    grid_scroll_to (top);
+  else if (top + grid_item_h > value + height)
+    grid_scroll_to (top + grid_item_h - height);
+}
+
+static void
+grid_activate (gint idx)
+{
+  GtkTreePath *path = gtk_tree_path_new_from_indices (idx, -1);
+  activate_cb (icon_view, path, NULL);
+  gtk_tree_path_free (path);
+}
+
+static void
+grid_draw_item (GtkWidget * w, cairo_t * cr, PangoLayout * layout, GdkPixbuf * pb, gint x, gint y, gboolean selected)
+{
+#if GTK_CHECK_VERSION(3,0,0)
+  GtkStyleContext *ctx = gtk_widget_get_style_context (w);
 
-  if (first_time)
+  gtk_style_context_save (ctx);
+  if (selected)
     {
-      first_time = FALSE;
-      gtk_list_store_append (GTK_LIST_STORE (model), &iter);
-      gtk_list_store_set (GTK_LIST_STORE (model), &iter, COL_FILENAME, "", -1);
+      gtk_style_context_set_state (ctx, GTK_STATE_FLAG_SELECTED);
+      gtk_render_background (ctx, cr, x, y, grid_item_w, grid_item_h);
     }
+  gtk_render_layout (ctx, cr, x + GRID_PADDING, y + icon_size + 2 * GRID_PADDING, layout);
+  gtk_style_context_restore (ctx);
+#else
+  GtkStyle *style = gtk_widget_get_style (w);
 
-  if ((condition == G_IO_IN) || (condition == G_IO_IN + G_IO_HUP))
+  if (selected)
     {
-      GError *err = NULL;
-      GString *string = g_string_new (NULL);
+      gdk_cairo_set_source_color (cr, &style->base[GTK_STATE_SELECTED]);
+      cairo_rectangle (cr, x, y, grid_item_w, grid_item_h);
+      cairo_fill (cr);
+    }
+  gdk_cairo_set_source_color (cr, &style->text[selected ? GTK_STATE_SELECTED : GTK_STATE_NORMAL]);
+  cairo_move_to (cr, x + GRID_PADDING, y + icon_size + 2 * GRID_PADDING);
+  pango_cairo_show_layout (cr, layout);
+#endif
 
-      while (channel->is_readable != TRUE);
+  if (pb)
+    {
+      gint pw = gdk_pixbuf_get_width (pb);
+      gint ph = gdk_pixbuf_get_height (pb);
+
+      cairo_save (cr);
+      cairo_rectangle (cr, x, y + GRID_PADDING, grid_item_w, icon_size);
+      cairo_clip (cr);
+      gdk_cairo_set_source_pixbuf (cr, pb, x + (grid_item_w - pw) / 2, y + GRID_PADDING + (icon_size - ph) / 2);
+      cairo_paint (cr);
+      cairo_restore (cr);
+    }
+}
 
-      do
-        {
-          GdkPixbuf *pb;
-          gint status;
+/* draw only visible items */
+static void
+grid_draw (GtkWidget * w, cairo_t * cr)
+{
+  GtkAllocation alloc;
+  GtkTreeIter iter;
+  PangoLayout *layout;
+  gint value, first, last, sel, i;
 
-          do
-            {
-              status = g_io_channel_read_line_string (channel, string, NULL, &err);
+#if GTK_CHECK_VERSION(2,18,0)
+  gtk_widget_get_allocation (w, &alloc);
+#else
+  alloc = w->allocation;
+#endif
 
-              while (gtk_events_pending ())
-                gtk_main_iteration ();
-            }
-          while (status == G_IO_STATUS_AGAIN);
-          strip_new_line (string->str);
+#if GTK_CHECK_VERSION(3,0,0)
+  gtk_render_background (gtk_widget_get_style_context (w), cr, 0, 0, alloc.width, alloc.height);
+#else
+  gdk_cairo_set_source_color (cr, &gtk_widget_get_style (w)->base[GTK_STATE_NORMAL]);
+  cairo_paint (cr);
+#endif
 
-          if (status != G_IO_STATUS_NORMAL)
-            {
-              if (err)
-                {
-                  g_printerr ("yad_icons_handle_stdin(): %s\n", err->message);
-                  g_error_free (err);
-                  err = NULL;
-                }
-              /* stop handling */
-              g_io_channel_shutdown (channel, TRUE, NULL);
-              return FALSE;
-            }
+  value = gtk_adjustment_get_value (grid_adj);
+  first = (value / grid_item_h) * grid_cols;
+  last = MIN (grid_n_items (), ((value + alloc.height) / grid_item_h + 1) * grid_cols);
+  if (first >= last || !gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (store), &iter, NULL, first))
+    return;
 
-          /* clear list if ^L received */
-          if (string->str[0] == '\014')
-            {
-              gtk_list_store_clear (GTK_LIST_STORE (model));
-              row_count = 0;
-              column_count = 1;
-              continue;
-            }
+  sel = grid_selected ();
 
-          if (column_count == NUM_COLS)
-            {
-              /* We're starting a new row */
-              column_count = 1;
-              row_count++;
-              gtk_list_store_append (GTK_LIST_STORE (model), &iter);
-              gtk_list_store_set (GTK_LIST_STORE (model), &iter, COL_FILENAME, "", -1);
-            }
+  layout = gtk_widget_create_pango_layout (w, NULL);
+  pango_layout_set_width (layout, (grid_item_w - 2 * GRID_PADDING) * PANGO_SCALE);
+  pango_layout_set_height (layout, -GRID_TEXT_LINES);
+  pango_layout_set_wrap (layout, PANGO_WRAP_WORD_CHAR);
+  pango_layout_set_ellipsize (layout, PANGO_ELLIPSIZE_END);
+  pango_layout_set_alignment (layout, PANGO_ALIGN_CENTER);
+
+  for (i = first; i < last; i++)
+    {
+      gchar *name;
+      GdkPixbuf *pb;
+
+      gtk_tree_model_get (GTK_TREE_MODEL (store), &iter, COL_NAME, &name, COL_PIXBUF, &pb, -1);
+      pango_layout_set_text (layout, name ? name : "", -1);
+      grid_draw_item (w, cr, layout, pb, (i % grid_cols) * grid_item_w, (i / grid_cols) * grid_item_h - value, i == sel);
+      g_free (name);
+      if (pb)
+        g_object_unref (pb);
+
+      if (!gtk_tree_model_iter_next (GTK_TREE_MODEL (store), &iter))
+        break;
+    }
+
+  g_object_unref (layout);
+}
+
+#if GTK_CHECK_VERSION(3,0,0)
+static gboolean
+grid_draw_cb (GtkWidget * w, cairo_t * cr, gpointer data)
+{
+  grid_draw (w, cr);
+  return TRUE;
+}
+#else
+static gboolean
+grid_expose_cb (GtkWidget * w, GdkEventExpose * ev, gpointer data)
+{
+  cairo_t *cr = gdk_cairo_create (gtk_widget_get_window (w));
+
+  gdk_cairo_region (cr, ev->region);
+  cairo_clip (cr);
+  grid_draw (w, cr);
+  cairo_destroy (cr);
+
+  return TRUE;
+}
+#endif
+
+static gboolean
+grid_button_cb (GtkWidget * w, GdkEventButton * ev, gpointer data)
+{
+  gint idx;
+
+  if (ev->button != 1)
+    return FALSE;
+
+  gtk_widget_grab_focus (w);
+
+  idx = grid_item_at (ev->x, ev->y);
+  if (ev->type == GDK_BUTTON_PRESS)
+    {
+      grid_select (idx);
+      if (idx >= 0 && options.icons_data.single_click)
+        grid_activate (idx);
+    }
+  else if (ev->type == GDK_2BUTTON_PRESS && idx >= 0 && !options.icons_data.single_click)
+    grid_activate (idx);
+
+  return TRUE;
+}
+
+static gboolean
+grid_key_cb (GtkWidget * w, GdkEventKey * ev, gpointer data)
+{
+  gint n, sel, page, idx;
+
+  n = grid_n_items ();
+  if (n == 0)
+    return FALSE;
+
+  sel = grid_selected ();
+  page = MAX (1, (gint) gtk_adjustment_get_page_size (grid_adj) / grid_item_h) * grid_cols;
+
+  switch (ev->keyval)
+    {
+#if GTK_CHECK_VERSION(2,24,0)
+    case GDK_KEY_Left:
+#else
+    case GDK_Left:
+#endif
+      idx = sel - 1;
+      break;
+#if GTK_CHECK_VERSION(2,24,0)
+    case GDK_KEY_Right:
+#else
+    case GDK_Right:
+#endif
+      idx = sel + 1;
+      break;
+#if GTK_CHECK_VERSION(2,24,0)
+    case GDK_KEY_Up:
+#else
+    case GDK_Up:
+#endif
+      idx = sel - grid_cols;
+      break;
+#if GTK_CHECK_VERSION(2,24,0)
+    case GDK_KEY_Down:
+#else
+    case GDK_Down:
+#endif
+      idx = sel < 0 ? 0 : sel + grid_cols;
+      break;
+#if GTK_CHECK_VERSION(2,24,0)
+    case GDK_KEY_Page_Up:
+#else
+    case GDK_Page_Up:
+#endif
+      idx = sel - page;
+      break;
+#if GTK_CHECK_VERSION(2,24,0)
+    case GDK_KEY_Page_Down:
+#else
+    case GDK_Page_Down:
+#endif
+      idx = sel + page;
+      break;
+#if GTK_CHECK_VERSION(2,24,0)
+    case GDK_KEY_Home:
+#else
+    case GDK_Home:
+#endif
+      idx = 0;
+      break;
+#if GTK_CHECK_VERSION(2,24,0)
+    case GDK_KEY_End:
+#else
+    case GDK_End:
+#endif
+      idx = n - 1;
+      break;
+#if GTK_CHECK_VERSION(2,24,0)
+    case GDK_KEY_Return:
+    case GDK_KEY_KP_Enter:
+    case GDK_KEY_space:
+#else
+    case GDK_Return:
+    case GDK_KP_Enter:
+    case GDK_space:
+#endif
+      if (sel >= 0)
+        grid_activate (sel);
+      return TRUE;
+    default:
+      return FALSE;
+    }
+
+  grid_select (CLAMP (idx, 0, n - 1));
+  return TRUE;
+}
+
+static gboolean
+grid_scroll_cb (GtkWidget * w, GdkEventScroll * ev, gpointer data)
+{
+  gdouble value = gtk_adjustment_get_value (grid_adj);
+
+  if (ev->direction == GDK_SCROLL_UP)
+    value -= gtk_adjustment_get_step_increment (grid_adj);
+  else if (ev->direction == GDK_SCROLL_DOWN)
+    value += gtk_adjustment_get_step_increment (grid_adj);
+  else
+    return FALSE;
+
+  grid_scroll_to (value);
+  return TRUE;
+}
+
+static gboolean
+grid_tooltip_cb (GtkWidget * w, gint x, gint y, gboolean kbd, GtkTooltip * tip, gpointer data)
+{
+  GtkTreeIter iter;
+  GdkRectangle area;
+  gchar *text = NULL;
+  gint idx;
+
+  idx = kbd ? grid_selected () : grid_item_at (x, y);
+  if (idx < 0 || !gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (store), &iter, NULL, idx))
+    return FALSE;
 
-          switch (column_count)
+  gtk_tree_model_get (GTK_TREE_MODEL (store), &iter, COL_TOOLTIP, &text, -1);
+  if (!text || !text[0])
+    {
+      g_free (text);
+      return FALSE;
+    }
+
+  gtk_tooltip_set_markup (tip, text);
+  g_free (text);
+
+  /* show new tooltip when pointer moves to other item */
+  area.x = (idx % grid_cols) * grid_item_w;
+  area.y = (idx / grid_cols) * grid_item_h - (gint) gtk_adjustment_get_value (grid_adj);
+  area.width = grid_item_w;
+  area.height = grid_item_h;
+  gtk_tooltip_set_tip_area (tip, &area);
+
+  return TRUE;
+}
+
+static GtkWidget *
+grid_create ()
+{
+  GtkWidget *box, *sb;
+
+  grid_adj = (GtkAdjustment *) gtk_adjustment_new (0, 0, 0, 0, 0, 0);
+
+  icon_view = gtk_drawing_area_new ();
+  gtk_widget_set_name (icon_view, "yad-icons-grid");
+#if GTK_CHECK_VERSION(2,18,0)
+  gtk_widget_set_can_focus (icon_view, TRUE);
+#else
+  GTK_WIDGET_SET_FLAGS (icon_view, GTK_CAN_FOCUS);
+#endif
+  gtk_widget_set_has_tooltip (icon_view, TRUE);
+  gtk_widget_add_events (icon_view, GDK_BUTTON_PRESS_MASK | GDK_KEY_PRESS_MASK | GDK_SCROLL_MASK);
+
+#if GTK_CHECK_VERSION(3,0,0)
+  gtk_style_context_add_class (gtk_widget_get_style_context (icon_view), GTK_STYLE_CLASS_VIEW);
+  g_signal_connect (G_OBJECT (icon_view), "draw", G_CALLBACK (grid_draw_cb), NULL);
+  box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
+  sb = gtk_scrollbar_new (GTK_ORIENTATION_VERTICAL, grid_adj);
+#else
+  g_signal_connect (G_OBJECT (icon_view), "expose-event", G_CALLBACK (grid_expose_cb), NULL);
+  box = gtk_hbox_new (FALSE, 0);
+  sb = gtk_vscrollbar_new (grid_adj);
+#endif
+
+  g_signal_connect (G_OBJECT (icon_view), "button-press-event", G_CALLBACK (grid_button_cb), NULL);
+  g_signal_connect (G_OBJECT (icon_view), "key-press-event", G_CALLBACK (grid_key_cb), NULL);
+  g_signal_connect (G_OBJECT (icon_view), "scroll-event", G_CALLBACK (grid_scroll_cb), NULL);
+  g_signal_connect (G_OBJECT (icon_view), "query-tooltip", G_CALLBACK (grid_tooltip_cb), NULL);
+  g_signal_connect_swapped (G_OBJECT (icon_view), "size-allocate", G_CALLBACK (grid_queue_update), NULL);
+  g_signal_connect_swapped (G_OBJECT (grid_adj), "value-changed", G_CALLBACK (gtk_widget_queue_draw), icon_view);
+
+  g_signal_connect_swapped (G_OBJECT (store), "row-inserted", G_CALLBACK (grid_queue_update), NULL);
+  g_signal_connect_swapped (G_OBJECT (store), "row-deleted", G_CALLBACK (grid_queue_update), NULL);
+  g_signal_connect_swapped (G_OBJECT (store), "row-changed", G_CALLBACK (grid_queue_update), NULL);
+  g_signal_connect_swapped (G_OBJECT (store), "rows-reordered", G_CALLBACK (grid_queue_update), NULL);
+
+  gtk_box_pack_start (GTK_BOX (box), icon_view, TRUE, TRUE, 0);
+  gtk_box_pack_start (GTK_BOX (box), sb, FALSE, FALSE, 0);
+
+  grid_measure ();
+
+  return box;
+}
+
+static gboolean
+input_line_cb (gchar * line, gpointer data)
+{
+  /* clear list if ^L received */
+  if (line[0] == '\014')
+    {
+      gtk_list_store_clear (store);
+      in_column = COL_NAME;
+      return TRUE;
+    }
+
+  if (in_column > COL_TERM)
+    in_column = COL_NAME;
+
+  if (in_column == COL_NAME)
+    {
+      /* we're starting a new row */
+      gtk_list_store_append (store, &in_iter);
+      gtk_list_store_set (store, &in_iter, COL_FILENAME, "", -1);
+    }
+
+  switch (in_column)
+    {
+    case COL_NAME:
+    case COL_COMMAND:
+      gtk_list_store_set (store, &in_iter, in_column, line, -1);
+      break;
+    case COL_TOOLTIP:
+      {
+        gchar *buf = g_markup_escape_text (line, -1);
+        gtk_list_store_set (store, &in_iter, in_column, buf, -1);
+        g_free (buf);
+        break;
+      }
+    case COL_PIXBUF:
+      {
+        GdkPixbuf *pb;
+
+        if (options.icons_data.compact)
+          if (*line)
+            pb = get_pixbuf (line, YAD_SMALL_ICON);
+          else
+            pb = NULL;
+        else
+          pb = get_pixbuf (line, YAD_BIG_ICON);
+        gtk_list_store_set (store, &in_iter, in_column, pb, -1);
+        if (pb)
+          g_object_unref (pb);
+        break;
+      }
+    case COL_TERM:
+      gtk_list_store_set (store, &in_iter, in_column, strcasecmp (line, "true") == 0, -1);
+      break;
+    }
+
+  in_column++;
+  return TRUE;
+}
+
+/* all available lines are added at once */
+static gboolean
+handle_stdin (GIOChannel * channel, GIOCondition condition, gpointer data)
+{
+  gchar buf[READ_BLOCK_SIZE];
+  gboolean eof = FALSE;
+  gint n;
+
+  for (n = 0; n < MAX_READ_BLOCKS; n++)
+    {
+      GIOStatus status;
+      GError *err = NULL;
+      gsize len = 0;
+
+      status = g_io_channel_read_chars (channel, buf, READ_BLOCK_SIZE, &len, &err);
+      if (len > 0)
+        g_string_append_len (in_buf, buf, len);
+
+      if (status == G_IO_STATUS_AGAIN)
+        break;
+      if (status != G_IO_STATUS_NORMAL)
+        {
+          if (err)
             {
-            case COL_NAME:
-            case COL_COMMAND:
-              gtk_list_store_set (GTK_LIST_STORE (model), &iter, column_count, string->str, -1);
-              break;
-            case COL_TOOLTIP:
-              {
-                gchar *buf = g_markup_escape_text (string->str, -1);
-                gtk_list_store_set (GTK_LIST_STORE (model), &iter, column_count, buf, -1);
-                g_free (buf);
-                break;
-              }
-            case COL_PIXBUF:
-              if (options.icons_data.compact)
-                if (*string->str)
-                  pb = get_pixbuf (string->str, YAD_SMALL_ICON);
-                else
-                  pb = NULL;
-              else
-                pb = get_pixbuf (string->str, YAD_BIG_ICON);
-              gtk_list_store_set (GTK_LIST_STORE (model), &iter, column_count, pb, -1);
-              if (pb)
-                g_object_unref (pb);
-              break;
-            case COL_TERM:
-              if (strcasecmp (string->str, "true") == 0)
-                gtk_list_store_set (GTK_LIST_STORE (model), &iter, column_count, TRUE, -1);
-              else
-                gtk_list_store_set (GTK_LIST_STORE (model), &iter, column_count, FALSE, -1);
-              break;
+              g_printerr ("yad_icons_handle_stdin(): %s\n", err->message);
+              g_error_free (err);
             }
-
-          column_count++;
+          eof = TRUE;
+          break;
         }
-      while (g_io_channel_get_buffer_condition (channel) == G_IO_IN);
-      g_string_free (string, TRUE);
     }
 
-  if ((condition != G_IO_IN) && (condition != G_IO_IN + G_IO_HUP))
+  process_lines (in_buf, eof, input_line_cb, NULL);
+
+  if (eof || ((condition & G_IO_HUP) && !(condition & G_IO_IN)))
     {
       g_io_channel_shutdown (channel, TRUE, NULL);
       return FALSE;
@@ -320,15 +856,12 @@ parse_desktop_file (gchar * filename)
                 }
             }
 
-          /* add icon */
+          /* get icon. it will be loaded later */
           icon = g_key_file_get_string (kf, "Desktop Entry", "Icon", NULL);
           if (icon)
             {
-              if (options.icons_data.compact)
-                ent->pixbuf = get_pixbuf (icon, YAD_SMALL_ICON);
-              else
-                ent->pixbuf = get_pixbuf (icon, YAD_BIG_ICON);
-              g_free (icon);
+              ent->icon = icon;
+              ent->icon_is_file = g_file_test (icon, G_FILE_TEST_EXISTS);
             }
         }
     }
@@ -340,6 +873,458 @@ parse_desktop_file (gchar * filename)
   return ent;
 }
 
+static void
+free_dentry (DEntry * ent)
+{
+  if (ent == NULL)
+    return;
+
+  g_free (ent->name);
+  g_free (ent->comment);
+  g_free (ent->icon);
+  g_free (ent->command);
+  g_free (ent);
+}
+
+static void
+free_job (IconJob * job)
+{
+  g_free (job->filename);
+  free_dentry (job->ent);
+  g_free (job->path);
+  if (job->pixbuf)
+    g_object_unref (job->pixbuf);
+  g_free (job);
+}
+
+static gboolean deliver_results (gpointer data);
+
+static void
+icons_worker (IconJob * job, gpointer data)
+{
+  /* outdated jobs are returned without processing for counting */
+  if (job->gen == g_atomic_int_get (&load_gen))
+    {
+      if (job->type == JOB_PARSE)
+        {
+          struct stat st;
+          gchar *fullname = g_build_filename (options.icons_data.directory, job->filename, NULL);
+
+          /* take file stamp before parsing, so the later changes invalidates the cache */
+          if (g_stat (fullname, &st) == 0)
+            {
+              job->mtime = st.st_mtime;
+              job->fsize = st.st_size;
+            }
+          job->ent = parse_desktop_file (fullname);
+          g_free (fullname);
+        }
+      else
+        {
+          GError *err = NULL;
+
+          if (job->size > 0)
+            job->pixbuf = gdk_pixbuf_new_from_file_at_size (job->path, job->size, job->size, &err);
+          else
+            job->pixbuf = gdk_pixbuf_new_from_file (job->path, &err);
+          if (err)
+            {
+              g_printerr ("yad_get_pixbuf(): %s\n", err->message);
+              g_error_free (err);
+            }
+        }
+    }
+
+  g_async_queue_push (results, job);
+  if (g_atomic_int_compare_and_exchange (&deliver_pending, 0, 1))
+    g_idle_add (deliver_results, NULL);
+}
+
+static void
+push_job (IconJob * job)
+{
+  if (icons_pool == NULL)
+    {
+      gint n;
+
+#if GLIB_CHECK_VERSION(2,36,0)
+      n = g_get_num_processors ();
+#else
+      n = 4;
+#endif
+      results = g_async_queue_new ();
+      icons_pool = g_thread_pool_new ((GFunc) icons_worker, NULL, n, FALSE, NULL);
+    }
+
+  job->gen = g_atomic_int_get (&load_gen);
+  pending_jobs++;
+  g_thread_pool_push (icons_pool, job, NULL);
+}
+
+/* find icon file in theme and start decoding */
+static void
+load_icon (const gchar * filename, DEntry * ent)
+{
+  IconJob *job;
+  gchar *path = NULL;
+  gint size = -1;
+
+  if (ent->icon_is_file)
+    path = g_strdup (ent->icon);
+  else
+    {
+      GtkIconInfo *info;
+
+      size = icon_size;
+      info = gtk_icon_theme_lookup_icon (settings.icon_theme, ent->icon, size, GTK_ICON_LOOKUP_GENERIC_FALLBACK);
+      if (info)
+        {
+          path = g_strdup (gtk_icon_info_get_filename (info));
+#if GTK_CHECK_VERSION(3,8,0)
+          g_object_unref (info);
+#else
+          gtk_icon_info_free (info);
+#endif
+        }
+    }
+
+  /* placeholder will be kept */
+  if (path == NULL)
+    return;
+
+  job = g_new0 (IconJob, 1);
+  job->type = JOB_DECODE;
+  job->filename = g_strdup (filename);
+  job->path = path;
+  job->size = size;
+  push_job (job);
+}
+
+static void
+remove_entry (const gchar * filename)
+{
+  GtkTreeIter *iter = g_hash_table_lookup (rows, filename);
+
+  if (iter)
+    {
+      gtk_list_store_remove (store, iter);
+      g_hash_table_remove (rows, filename);
+      cache_dirty = TRUE;
+    }
+}
+
+/* add new row or update the existing one */
+static void
+set_row (const gchar * filename, const gchar * name, const gchar * comment, const gchar * command,
+         gboolean in_term, GdkPixbuf * pb, gint64 mtime, gint64 size)
+{
+  GtkTreeIter *iter, new_iter;
+
+  iter = g_hash_table_lookup (rows, filename);
+  if (iter == NULL)
+    {
+      gtk_list_store_append (store, &new_iter);
+      g_hash_table_insert (rows, g_strdup (filename), gtk_tree_iter_copy (&new_iter));
+      iter = &new_iter;
+    }
+
+  gtk_list_store_set (store, iter,
+                      COL_FILENAME, filename,
+                      COL_NAME, name,
+                      COL_TOOLTIP, comment ? comment : "",
+                      COL_PIXBUF, pb,
+                      COL_COMMAND, command ? command : "",
+                      COL_TERM, in_term, COL_MTIME, mtime, COL_SIZE, size, -1);
+}
+
+static void
+add_entry (const gchar * filename, DEntry * ent, gint64 mtime, gint64 size)
+{
+  GdkPixbuf *placeholder;
+
+  if (options.icons_data.compact)
+    placeholder = settings.small_fallback_image;
+  else
+    placeholder = settings.big_fallback_image;
+
+  set_row (filename, ent->name, ent->comment, ent->command, ent->in_term, placeholder, mtime, size);
+  cache_dirty = TRUE;
+
+  if (ent->icon)
+    load_icon (filename, ent);
+}
+
+static gchar *
+get_cache_name ()
+{
+  gchar *dir, *theme = NULL, *key, *sum, *name, *res;
+
+  if (g_path_is_absolute (options.icons_data.directory))
+    dir = g_strdup (options.icons_data.directory);
+  else
+    {
+      gchar *cwd = g_get_current_dir ();
+      dir = g_build_filename (cwd, options.icons_data.directory, NULL);
+      g_free (cwd);
+    }
+
+  if (options.data.icon_theme)
+    theme = g_strdup (options.data.icon_theme);
+  else
+    g_object_get (gtk_settings_get_default (), "gtk-icon-theme-name", &theme, NULL);
+
+  /* everything what changes the content of iconbox goes to the key */
+  key = g_strdup_printf ("%s\n%d\n%s\n%d\n%s", dir, options.icons_data.generic,
+                         g_get_language_names ()[0], icon_size, theme ? theme : "");
+  sum = g_compute_checksum_for_string (G_CHECKSUM_MD5, key, -1);
+  name = g_strdup_printf ("icons-%s.cache", sum);
+  res = g_build_filename (g_get_user_cache_dir (), "yad", name, NULL);
+
+  g_free (dir);
+  g_free (theme);
+  g_free (key);
+  g_free (sum);
+  g_free (name);
+
+  return res;
+}
+
+static const gchar *
+cache_string (guint32 offset)
+{
+  const gchar *data = g_mapped_file_get_contents (cache_map);
+  gsize len = g_mapped_file_get_length (cache_map);
+
+  if (offset < sizeof (CacheHeader) || offset >= len || memchr (data + offset, 0, len - offset) == NULL)
+    return NULL;
+
+  return data + offset;
+}
+
+/* pixbuf uses mapped data directly */
+static GdkPixbuf *
+cache_pixbuf (const CacheRecord * rec)
+{
+  guchar *data = (guchar *) g_mapped_file_get_contents (cache_map);
+  gsize len = g_mapped_file_get_length (cache_map);
+  guint nch = rec->has_alpha ? 4 : 3;
+
+  if (rec->pixels == 0 || rec->width == 0 || rec->height == 0 ||
+      rec->width > CACHE_MAX_ICON || rec->height > CACHE_MAX_ICON || rec->rowstride < rec->width * nch)
+    return NULL;
+  if ((guint64) rec->pixels + (guint64) rec->rowstride * (rec->height - 1) + rec->width * nch > len)
+    return NULL;
+
+  return gdk_pixbuf_new_from_data (data + rec->pixels, GDK_COLORSPACE_RGB, rec->has_alpha, 8,
+                                   rec->width, rec->height, rec->rowstride, NULL, NULL);
+}
+
+static void
+load_cache ()
+{
+  const gchar *data;
+  const CacheHeader *hdr;
+  const CacheRecord *rec;
+  gsize len;
+  guint i;
+
+  cache_file = get_cache_name ();
+  cache_entries = g_hash_table_new (g_str_hash, g_str_equal);
+
+  /* mapping is kept until exit, because cached pixbufs refers to it */
+  cache_map = g_mapped_file_new (cache_file, FALSE, NULL);
+  if (cache_map == NULL)
+    return;
+
+  data = g_mapped_file_get_contents (cache_map);
+  len = g_mapped_file_get_length (cache_map);
+  hdr = (const CacheHeader *) data;
+  if (len < sizeof (CacheHeader) || memcmp (hdr->magic, CACHE_MAGIC, 8) != 0 ||
+      hdr->version != CACHE_VERSION || hdr->n_entries > (len - sizeof (CacheHeader)) / sizeof (CacheRecord))
+    {
+      g_mapped_file_unref (cache_map);
+      cache_map = NULL;
+      return;
+    }
+
+  rec = (const CacheRecord *) (data + sizeof (CacheHeader));
+  for (i = 0; i < hdr->n_entries; i++)
+    {
+      const gchar *filename = cache_string (rec[i].filename);
+
+      if (filename && cache_string (rec[i].name))
+        g_hash_table_insert (cache_entries, (gpointer) filename, (gpointer) &rec[i]);
+    }
+}
+
+static void
+add_cached_entry (const gchar * filename, const CacheRecord * rec)
+{
+  GdkPixbuf *pb = cache_pixbuf (rec);
+
+  if (pb == NULL)
+    pb = g_object_ref (options.icons_data.compact ? settings.small_fallback_image : settings.big_fallback_image);
+
+  set_row (filename, cache_string (rec->name), cache_string (rec->comment), cache_string (rec->command),
+           rec->in_term, pb, rec->mtime, rec->size);
+  g_object_unref (pb);
+}
+
+static guint32
+cache_add_string (GByteArray * buf, const gchar * str)
+{
+  guint32 offset = buf->len;
+
+  if (str == NULL)
+    return 0;
+
+  g_byte_array_append (buf, (const guint8 *) str, strlen (str) + 1);
+  return offset;
+}
+
+static void
+cache_add_pixbuf (GByteArray * buf, CacheRecord * rec, GdkPixbuf * pb)
+{
+  const guint8 *pixels;
+  guint i, stride, row_len;
+
+  if (gdk_pixbuf_get_colorspace (pb) != GDK_COLORSPACE_RGB || gdk_pixbuf_get_bits_per_sample (pb) != 8)
+    return;
+
+  rec->has_alpha = gdk_pixbuf_get_has_alpha (pb);
+  rec->width = gdk_pixbuf_get_width (pb);
+  rec->height = gdk_pixbuf_get_height (pb);
+  if (rec->width > CACHE_MAX_ICON || rec->height > CACHE_MAX_ICON)
+    return;
+
+  /* align pixels data and write rows without padding */
+  g_byte_array_set_size (buf, (buf->len + 7) & ~7);
+  rec->pixels = buf->len;
+  row_len = rec->width * gdk_pixbuf_get_n_channels (pb);
+  rec->rowstride = row_len;
+
+  pixels = gdk_pixbuf_get_pixels (pb);
+  stride = gdk_pixbuf_get_rowstride (pb);
+  for (i = 0; i < rec->height; i++)
+    g_byte_array_append (buf, pixels + i * stride, row_len);
+}
+
+static void
+save_cache ()
+{
+  GByteArray *buf;
+  GArray *recs;
+  GHashTableIter it;
+  gchar *filename, *dir;
+  GtkTreeIter *iter;
+  CacheHeader hdr;
+  GError *err = NULL;
+
+  cache_dirty = FALSE;
+  if (cache_file == NULL)
+    return;
+
+  buf = g_byte_array_new ();
+  recs = g_array_new (FALSE, TRUE, sizeof (CacheRecord));
+
+  /* reserve space for header and records */
+  g_byte_array_set_size (buf, sizeof (CacheHeader) + g_hash_table_size (rows) * sizeof (CacheRecord));
+
+  g_hash_table_iter_init (&it, rows);
+  while (g_hash_table_iter_next (&it, (gpointer *) &filename, (gpointer *) &iter))
+    {
+      CacheRecord rec;
+      gchar *name, *comment, *command;
+      gboolean in_term;
+      GdkPixbuf *pb;
+
+      memset (&rec, 0, sizeof (CacheRecord));
+      gtk_tree_model_get (GTK_TREE_MODEL (store), iter, COL_NAME, &name, COL_TOOLTIP, &comment,
+                          COL_COMMAND, &command, COL_TERM, &in_term, COL_PIXBUF, &pb,
+                          COL_MTIME, &rec.mtime, COL_SIZE, &rec.size, -1);
+
+      rec.filename = cache_add_string (buf, filename);
+      rec.name = cache_add_string (buf, name);
+      rec.comment = cache_add_string (buf, comment);
+      rec.command = cache_add_string (buf, command);
+      rec.in_term = in_term;
+      if (pb && pb != settings.small_fallback_image && pb != settings.big_fallback_image)
+        cache_add_pixbuf (buf, &rec, pb);
+
+      g_array_append_val (recs, rec);
+
+      if (pb)
+        g_object_unref (pb);
+      g_free (name);
+      g_free (comment);
+      g_free (command);
+    }
+
+  memset (&hdr, 0, sizeof (CacheHeader));
+  memcpy (hdr.magic, CACHE_MAGIC, 8);
+  hdr.version = CACHE_VERSION;
+  hdr.n_entries = recs->len;
+  memcpy (buf->data, &hdr, sizeof (CacheHeader));
+  memcpy (buf->data + sizeof (CacheHeader), recs->data, recs->len * sizeof (CacheRecord));
+
+  /* file is replaced atomically, so the current mapping stays valid */
+  dir = g_path_get_dirname (cache_file);
+  g_mkdir_with_parents (dir, 0700);
+  if (!g_file_set_contents (cache_file, (const gchar *) buf->data, buf->len, &err))
+    {
+      g_printerr (_("Unable to save icons cache: %s\n"), err->message);
+      g_error_free (err);
+    }
+
+  g_free (dir);
+  g_array_free (recs, TRUE);
+  g_byte_array_free (buf, TRUE);
+}
+
+/* insert parsed entries and decoded icons into the store by batches */
+static gboolean
+deliver_results (gpointer data)
+{
+  IconJob *job;
+  gint n;
+
+  for (n = 0; n < INSERT_BATCH && (job = g_async_queue_try_pop (results)) != NULL; n++)
+    {
+      pending_jobs--;
+      if (job->gen == g_atomic_int_get (&load_gen))
+        {
+          if (job->type == JOB_PARSE)
+            {
+              if (job->ent->name)
+                add_entry (job->filename, job->ent, job->mtime, job->fsize);
+              else
+                remove_entry (job->filename);
+            }
+          else if (job->pixbuf)
+            {
+              GtkTreeIter *iter = g_hash_table_lookup (rows, job->filename);
+              if (iter)
+                gtk_list_store_set (store, iter, COL_PIXBUF, job->pixbuf, -1);
+            }
+        }
+      free_job (job);
+    }
+
+  if (g_async_queue_length (results) > 0)
+    return TRUE;
+
+  /* all entries and icons are loaded */
+  if (pending_jobs == 0 && cache_dirty)
+    save_cache ();
+
+  g_atomic_int_set (&deliver_pending, 0);
+  /* new results may come while flag was set */
+  if (g_async_queue_length (results) > 0 && g_atomic_int_compare_and_exchange (&deliver_pending, 0, 1))
+    return TRUE;
+
+  return FALSE;
+}
+
 static void
 read_dir ()
 {
@@ -354,69 +1339,141 @@ read_dir ()
       return;
     }
 
+  /* drop results of previous reading */
+  g_atomic_int_inc (&load_gen);
   gtk_list_store_clear (store);
+  g_hash_table_remove_all (rows);
 
+  /* take unchanged entries from cache and parse the rest in worker threads */
   while ((filename = g_dir_read_name (dir)) != NULL)
     {
-      DEntry *ent;
-      GtkTreeIter iter;
-      gchar *fullname;
+      IconJob *job;
+      const CacheRecord *rec;
 
       if (!g_str_has_suffix (filename, ".desktop"))
         continue;
 
-      fullname = g_build_filename (options.icons_data.directory, filename, NULL);
-      ent = parse_desktop_file (fullname);
-      g_free (fullname);
-
-      if (ent->name)
+      rec = g_hash_table_lookup (cache_entries, filename);
+      if (rec)
         {
-          gtk_list_store_append (store, &iter);
-          gtk_list_store_set (store, &iter,
-                              COL_FILENAME, filename,
-                              COL_NAME, ent->name,
-                              COL_TOOLTIP, ent->comment ? ent->comment : "",
-                              COL_PIXBUF, ent->pixbuf,
-                              COL_COMMAND, ent->command ? ent->command : "", COL_TERM, ent->in_term, -1);
+          struct stat st;
+          gchar *fullname = g_build_filename (options.icons_data.directory, filename, NULL);
+          gboolean valid = (g_stat (fullname, &st) == 0 && st.st_mtime == rec->mtime && st.st_size == rec->size);
+
+          g_free (fullname);
+          if (valid)
+            {
+              add_cached_entry (filename, rec);
+              continue;
+            }
         }
 
-      /* free desktop entry */
-      g_free (ent->name);
-      g_free (ent->comment);
-      g_free (ent->command);
-      if (ent->pixbuf)
-        g_object_unref (ent->pixbuf);
-      g_free (ent);
+      job = g_new0 (IconJob, 1);
+      job->type = JOB_PARSE;
+      job->filename = g_strdup (filename);
+      push_job (job);
     }
 
   g_dir_close (dir);
+
+  /* some cached files were removed */
+  if (g_hash_table_size (rows) != g_hash_table_size (cache_entries))
+    cache_dirty = TRUE;
+  if (pending_jobs == 0 && cache_dirty)
+    save_cache ();
 }
 
 #ifdef HAVE_GIO
+/* reparse only changed files */
+static gboolean
+process_changes (gpointer data)
+{
+  GHashTableIter it;
+  gchar *filename;
+
+  g_hash_table_iter_init (&it, changed_files);
+  while (g_hash_table_iter_next (&it, (gpointer *) &filename, NULL))
+    {
+      gchar *fullname = g_build_filename (options.icons_data.directory, filename, NULL);
+
+      if (g_file_test (fullname, G_FILE_TEST_EXISTS))
+        {
+          IconJob *job = g_new0 (IconJob, 1);
+          job->type = JOB_PARSE;
+          job->filename = g_strdup (filename);
+          push_job (job);
+        }
+      else
+        remove_entry (filename);
+
+      g_free (fullname);
+    }
+  g_hash_table_remove_all (changed_files);
+
+  if (pending_jobs == 0 && cache_dirty)
+    save_cache ();
+
+  changes_timeout = 0;
+  return FALSE;
+}
+
 static void
 dir_changed_cb (GFileMonitor *mon, GFile *file, GFile *ofile, GFileMonitorEvent ev, gpointer data)
 {
-  if (ev == G_FILE_MONITOR_EVENT_DELETED || ev == G_FILE_MONITOR_EVENT_CREATED)
-    read_dir ();
+  gchar *filename;
+
+  if (ev != G_FILE_MONITOR_EVENT_DELETED && ev != G_FILE_MONITOR_EVENT_CREATED &&
+      ev != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT)
+    return;
+
+  filename = g_file_get_basename (file);
+  if (!g_str_has_suffix (filename, ".desktop"))
+    {
+      g_free (filename);
+      return;
+    }
+
+  /* collect the burst of events and handle each file once */
+  g_hash_table_replace (changed_files, filename, NULL);
+  if (changes_timeout == 0)
+    changes_timeout = g_timeout_add (CHANGES_DELAY, process_changes, NULL);
 }
 #endif
 
 GtkWidget *
 icons_create_widget (GtkWidget * dlg)
 {
-  GtkWidget *w;
+  GtkWidget *w, *child;
+  gint iw, ih;
+
+  if (options.icons_data.compact)
+    gtk_icon_size_lookup (GTK_ICON_SIZE_MENU, &iw, &ih);
+  else
+    gtk_icon_size_lookup (GTK_ICON_SIZE_DIALOG, &iw, &ih);
+  icon_size = MIN (iw, ih);
 
-  w = gtk_scrolled_window_new (NULL, NULL);
-  gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (w), GTK_SHADOW_ETCHED_IN);
-  gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (w), options.hscroll_policy, options.vscroll_policy);
+  if (options.icons_data.grid && !options.icons_data.compact)
+    {
+      /* grid has its own scrollbar */
+      w = gtk_frame_new (NULL);
+      gtk_frame_set_shadow_type (GTK_FRAME (w), GTK_SHADOW_ETCHED_IN);
+    }
+  else
+    {
+      w = gtk_scrolled_window_new (NULL, NULL);
+      gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (w), GTK_SHADOW_ETCHED_IN);
+      gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (w), options.hscroll_policy, options.vscroll_policy);
+    }
 
   store = gtk_list_store_new (NUM_COLS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
-                              GDK_TYPE_PIXBUF, G_TYPE_STRING, G_TYPE_BOOLEAN);
+                              GDK_TYPE_PIXBUF, G_TYPE_STRING, G_TYPE_BOOLEAN, G_TYPE_INT64, G_TYPE_INT64);
   gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (store),
                                         options.icons_data.sort_by_name ? COL_NAME : COL_FILENAME,
                                         options.icons_data.descend ? GTK_SORT_DESCENDING : GTK_SORT_ASCENDING);
 
-  if (!options.icons_data.compact)
+  if (options.icons_data.grid && !options.icons_data.compact)
+    child = grid_create ();
+  else if (!options.icons_data.compact)
     {
       icon_view = gtk_icon_view_new_with_model (GTK_TREE_MODEL (store));
       gtk_widget_set_name (icon_view, "yad-icons-full");
@@ -427,6 +1484,9 @@ icons_create_widget (GtkWidget * dlg)
 
       if (options.icons_data.single_click)
         g_signal_connect (G_OBJECT (icon_view), "selection-changed", G_CALLBACK (select_cb), NULL);
+      g_signal_connect (G_OBJECT (icon_view), "item-activated", G_CALLBACK (activate_cb), NULL);
+
+      child = icon_view;
     }
   else
     {
@@ -456,16 +1516,24 @@ icons_create_widget (GtkWidget * dlg)
           sel = gtk_tree_view_get_selection (GTK_TREE_VIEW (icon_view));
           g_signal_connect (G_OBJECT (sel), "changed", G_CALLBACK (select_cb), col);
         }
+      g_signal_connect (G_OBJECT (icon_view), "row-activated", G_CALLBACK (activate_cb), NULL);
+
+      child = icon_view;
     }
 
   /* handle directory */
   if (options.icons_data.directory)
-    read_dir ();
+    {
+      rows = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) gtk_tree_iter_free);
+      load_cache ();
+      read_dir ();
+    }
   else if (options.common_data.listen)
     {
       /* read from stdin */
       GIOChannel *channel;
 
+      in_buf = g_string_sized_new (READ_BLOCK_SIZE);
       channel = g_io_channel_unix_new (0);
       if (channel)
         {
@@ -475,11 +1543,6 @@ icons_create_widget (GtkWidget * dlg)
         }
     }
 
-  if (!options.icons_data.compact)
-    g_signal_connect (G_OBJECT (icon_view), "item-activated", G_CALLBACK (activate_cb), NULL);
-  else
-    g_signal_connect (G_OBJECT (icon_view), "row-activated", G_CALLBACK (activate_cb), NULL);
-
 #ifdef HAVE_GIO
   /* start file monitor */
   if (options.icons_data.monitor && options.icons_data.directory)
@@ -488,13 +1551,14 @@ icons_create_widget (GtkWidget * dlg)
       if (file)
         {
           GFileMonitor *mon = g_file_monitor_directory (file, 0, NULL, NULL);
+          changed_files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
           g_signal_connect (G_OBJECT (mon), "changed", G_CALLBACK (dir_changed_cb), NULL);
           g_object_unref (file);
         }
     }
 #endif
 
-  gtk_container_add (GTK_CONTAINER (w), icon_view);
+  gtk_container_add (GTK_CONTAINER (w), child);
 
   return w;
 }
@@ -771,6 +771,9 @@ main (gint argc, gchar ** argv)
   textdomain (GETTEXT_PACKAGE);
 #endif
 
+#if !GLIB_CHECK_VERSION(2,32,0)
+  g_thread_init (NULL);
+#endif
 #if !GLIB_CHECK_VERSION(2,36,0)
   g_type_init ();
 #endif
@@ -897,6 +900,8 @@ main (gint argc, gchar ** argv)
     {
       create_plug ();
       gtk_main ();
+      if (options.mode == YAD_MODE_SCALE)
+        scale_flush_partial ();
       shmdt (tabs);
       return ret;
     }
@@ -954,6 +959,10 @@ main (gint argc, gchar ** argv)
       /* run main loop */
       gtk_main ();
 
+      /* print delayed partial value before the result */
+      if (options.mode == YAD_MODE_SCALE)
+        scale_flush_partial ();
+
       /* print results */
       if (ret != YAD_RESPONSE_TIMEOUT && ret != YAD_RESPONSE_ESC)
         {
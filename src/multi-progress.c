@@ -26,8 +26,46 @@
 
 #include "yad.h"
 
-static GSList *progress_bars = NULL;
-static guint nbars = 0;
+#define READ_BLOCK_SIZE 4096
+#define MAX_READ_BLOCKS 64
+#define FRAME_INTERVAL 40       /* minimal interval between redraws in ms */
+#define MAX_UNSCROLLED_BARS 10  /* show scrollbar if there are more bars */
+
+typedef struct {
+  gchar *id;
+  YadProgressType type;
+  gint slot;
+  GtkWidget *label;
+  GtkWidget *bar;
+  gdouble fraction;             /* last received value */
+  gboolean tracked;             /* bar counts for auto-close */
+  guint pulse_id;
+  /* pending changes */
+  gboolean dirty;
+  gboolean new_fraction;
+  gboolean new_text;
+  gboolean pulse;
+  GString *text;
+} MultiBar;
+
+static GPtrArray *bars = NULL;          /* all of bar slots */
+static GPtrArray *dirty_bars = NULL;
+static GHashTable *bar_ids = NULL;      /* id -> active bar */
+static GSList *free_bars = NULL;        /* slots of removed bars */
+static guint nactive = 0;
+static gboolean watch_single = FALSE;   /* only one bar is watched for auto-close */
+static guint ntracked = 0;
+static guint ncomplete = 0;
+
+static GtkWidget *table;
+static GtkWidget *sw;
+
+static GString *in_buf = NULL;
+static guint render_timeout = 0;
+
+/* progress counters in shared memory */
+static YadShmCounter *shm_counters = NULL;
+static guint n_counters = 0;
 
 static gboolean
 pulsate_progress_bar (GtkProgressBar *bar)
@@ -36,171 +74,636 @@ pulsate_progress_bar (GtkProgressBar *bar)
   return TRUE;
 }
 
+/* checks if bar is inside the visible part of scrolled window */
 static gboolean
-handle_stdin (GIOChannel * channel, GIOCondition condition, gpointer data)
+bar_visible (MultiBar * b)
 {
-  float percentage = 0.0;
+  GtkAdjustment *adj;
+  GtkAllocation alloc;
+  gdouble val, pos, size;
 
-  if ((condition == G_IO_IN) || (condition == G_IO_IN + G_IO_HUP))
+  if (options.common_data.vertical)
     {
-      GString *string;
-      gchar **value;
-      GError *err = NULL;
+      adj = gtk_scrolled_window_get_hadjustment (GTK_SCROLLED_WINDOW (sw));
+#if GTK_CHECK_VERSION(2,18,0)
+      gtk_widget_get_allocation (b->bar, &alloc);
+#else
+      alloc = b->bar->allocation;
+#endif
+      pos = alloc.x;
+      size = alloc.width;
+    }
+  else
+    {
+      adj = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (sw));
+#if GTK_CHECK_VERSION(2,18,0)
+      gtk_widget_get_allocation (b->bar, &alloc);
+#else
+      alloc = b->bar->allocation;
+#endif
+      pos = alloc.y;
+      size = alloc.height;
+    }
 
-      string = g_string_new (NULL);
+  /* not allocated yet */
+  if (size <= 1)
+    return TRUE;
 
-      while (channel->is_readable != TRUE);
+  val = gtk_adjustment_get_value (adj);
+  return (pos + size >= val && pos <= val + gtk_adjustment_get_page_size (adj));
+}
 
-      do
+static void
+render_bars (void)
+{
+  guint i, n = 0;
+
+  for (i = 0; i < dirty_bars->len; i++)
+    {
+      MultiBar *b = g_ptr_array_index (dirty_bars, i);
+
+      /* changes of hidden bars are applied when they are scrolled in */
+      if (!bar_visible (b))
         {
-          gint status, num;
-          GtkProgressBar *pb;
-          YadProgressBar *b;
+          g_ptr_array_index (dirty_bars, n++) = b;
+          continue;
+        }
 
-          do
-            {
-              status = g_io_channel_read_line_string (channel, string, NULL, &err);
+      if (b->new_fraction)
+        gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (b->bar), b->fraction);
+      if (b->pulse)
+        gtk_progress_bar_pulse (GTK_PROGRESS_BAR (b->bar));
+      if (b->new_text)
+        gtk_progress_bar_set_text (GTK_PROGRESS_BAR (b->bar), b->text->str);
 
-              while (gtk_events_pending ())
-                gtk_main_iteration ();
+      b->new_fraction = b->new_text = b->pulse = FALSE;
+      b->dirty = FALSE;
+    }
+  g_ptr_array_set_size (dirty_bars, n);
+}
 
-            }
-          while (status == G_IO_STATUS_AGAIN);
+static gboolean
+render_bars_cb (gpointer data)
+{
+  render_timeout = 0;
+  render_bars ();
+  return FALSE;
+}
+
+static void
+schedule_render (void)
+{
+  if (render_timeout == 0 && dirty_bars->len)
+    render_timeout = g_timeout_add (FRAME_INTERVAL, render_bars_cb, NULL);
+}
+
+static void
+mark_dirty (MultiBar * b)
+{
+  if (!b->dirty)
+    {
+      b->dirty = TRUE;
+      g_ptr_array_add (dirty_bars, b);
+    }
+}
+
+static void
+set_fraction (MultiBar * b, gdouble val)
+{
+  if (val > 1.0)
+    val = 1.0;
+
+  if (b->tracked && (b->fraction >= 1.0) != (val >= 1.0))
+    {
+      if (val >= 1.0)
+        ncomplete++;
+      else
+        ncomplete--;
+    }
+
+  b->fraction = val;
+  b->new_fraction = TRUE;
+  mark_dirty (b);
+}
+
+/* in-place version of g_strcompress () */
+static void
+compress_text (gchar * str)
+{
+  gchar *s = str, *d = str;
+
+  while (*s)
+    {
+      if (*s != '\\' || !s[1])
+        {
+          *d++ = *s++;
+          continue;
+        }
+
+      s++;
+      if (*s >= '0' && *s <= '7')
+        {
+          gint i, c = 0;
+
+          for (i = 0; i < 3 && *s >= '0' && *s <= '7'; i++)
+            c = c * 8 + (*s++ - '0');
+          *d++ = c;
+          continue;
+        }
+
+      switch (*s)
+        {
+        case 'b':
+          *d++ = '\b';
+          break;
+        case 'f':
+          *d++ = '\f';
+          break;
+        case 'n':
+          *d++ = '\n';
+          break;
+        case 'r':
+          *d++ = '\r';
+          break;
+        case 't':
+          *d++ = '\t';
+          break;
+        case 'v':
+          *d++ = '\v';
+          break;
+        default:
+          *d++ = *s;
+          break;
+        }
+      s++;
+    }
+  *d = '\0';
+}
+
+/* limit the size of bars area to MAX_UNSCROLLED_BARS bars */
+static void
+set_scroll_size (void)
+{
+  MultiBar *b;
+  GtkRequisition lr, br;
+  gint size;
+
+  if (nactive <= MAX_UNSCROLLED_BARS)
+    {
+      gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (sw), GTK_POLICY_NEVER, GTK_POLICY_NEVER);
+      gtk_widget_set_size_request (sw, -1, -1);
+      return;
+    }
+
+  b = g_ptr_array_index (bars, 0);
+#if GTK_CHECK_VERSION(3,0,0)
+  gtk_widget_get_preferred_size (b->label, NULL, &lr);
+  gtk_widget_get_preferred_size (b->bar, NULL, &br);
+#else
+  gtk_widget_size_request (b->label, &lr);
+  gtk_widget_size_request (b->bar, &br);
+#endif
+
+  if (options.common_data.vertical)
+    {
+      size = (MAX (lr.width, br.width) + 4) * MAX_UNSCROLLED_BARS;
+      gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (sw), GTK_POLICY_AUTOMATIC, GTK_POLICY_NEVER);
+      gtk_widget_set_size_request (sw, size, -1);
+    }
+  else
+    {
+      size = (MAX (lr.height, br.height) + 4) * MAX_UNSCROLLED_BARS;
+      gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (sw), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+      gtk_widget_set_size_request (sw, -1, size);
+    }
+}
+
+static gint
+compare_slots (MultiBar * a, MultiBar * b)
+{
+  return a->slot - b->slot;
+}
+
+/* creates widgets for new bar slot */
+static MultiBar *
+create_bar (gint i)
+{
+  MultiBar *b;
+  GtkWidget *l, *w;
+
+  b = g_new0 (MultiBar, 1);
+  b->slot = i;
+  b->text = g_string_new (NULL);
 
-          if (status != G_IO_STATUS_NORMAL)
+  /* add label */
+  l = gtk_label_new (NULL);
+  gtk_misc_set_alignment (GTK_MISC (l), options.common_data.align, 0.5);
+  if (options.common_data.vertical)
+#if !GTK_CHECK_VERSION(3,0,0)
+    gtk_table_attach (GTK_TABLE (table), l, i, i + 1, 1, 2, GTK_FILL, 0, 2, 2);
+#else
+    gtk_grid_attach (GTK_GRID (table), l, i, 1, 1, 1);
+#endif
+  else
+#if !GTK_CHECK_VERSION(3,0,0)
+    gtk_table_attach (GTK_TABLE (table), l, 0, 1, i, i + 1, GTK_FILL, 0, 2, 2);
+#else
+    gtk_grid_attach (GTK_GRID (table), l, 0, i, 1, 1);
+#endif
+  b->label = l;
+
+  /* add progress bar */
+  w = gtk_progress_bar_new ();
+  gtk_widget_set_name (w, "yad-progress-widget");
+#if GTK_CHECK_VERSION(3,0,0)
+  gtk_progress_bar_set_show_text (GTK_PROGRESS_BAR (w), TRUE);
+  if (options.common_data.vertical)
+    gtk_orientable_set_orientation (GTK_ORIENTABLE (w), GTK_ORIENTATION_VERTICAL);
+#endif
+  if (options.common_data.vertical)
+    {
+#if !GTK_CHECK_VERSION(3,0,0)
+      gtk_table_attach (GTK_TABLE (table), w, i, i + 1, 0, 1, 0, GTK_FILL | GTK_EXPAND, 2, 2);
+#else
+      gtk_grid_attach (GTK_GRID (table), w, i, 0, 1, 1);
+      gtk_widget_set_vexpand (w, TRUE);
+#endif
+    }
+  else
+    {
+#if !GTK_CHECK_VERSION(3,0,0)
+      gtk_table_attach (GTK_TABLE (table), w, 1, 2, i, i + 1, GTK_FILL | GTK_EXPAND, 0, 2, 2);
+#else
+      gtk_grid_attach (GTK_GRID (table), w, 1, i, 1, 1);
+      gtk_widget_set_hexpand (w, TRUE);
+#endif
+    }
+  b->bar = w;
+
+  return b;
+}
+
+/* setup bar in a new or reused slot */
+static MultiBar *
+add_bar (const gchar * id, const gchar * name, YadProgressType type)
+{
+  MultiBar *b;
+  GtkWidget *w;
+
+  if (free_bars)
+    {
+      b = (MultiBar *) free_bars->data;
+      free_bars = g_slist_delete_link (free_bars, free_bars);
+    }
+  else
+    {
+      b = create_bar (bars->len);
+      g_ptr_array_add (bars, b);
+    }
+
+  b->id = g_strdup (id);
+  b->type = type;
+  b->fraction = 0.0;
+  b->new_fraction = b->new_text = b->pulse = FALSE;
+  b->tracked = (!watch_single && type != YAD_PROGRESS_PULSE);
+  g_hash_table_insert (bar_ids, b->id, b);
+
+  if (options.data.no_markup)
+    gtk_label_set_text (GTK_LABEL (b->label), name);
+  else
+    gtk_label_set_markup (GTK_LABEL (b->label), name);
+
+  w = b->bar;
+  gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (w), 0.0);
+  gtk_progress_bar_set_text (GTK_PROGRESS_BAR (w), NULL);
+#if GTK_CHECK_VERSION(3,0,0)
+  gtk_progress_bar_set_inverted (GTK_PROGRESS_BAR (w), type == YAD_PROGRESS_RTL);
+#else
+  if (type == YAD_PROGRESS_RTL)
+    {
+      if (options.common_data.vertical)
+        gtk_progress_bar_set_orientation (GTK_PROGRESS_BAR (w), GTK_PROGRESS_TOP_TO_BOTTOM);
+      else
+        gtk_progress_bar_set_orientation (GTK_PROGRESS_BAR (w), GTK_PROGRESS_RIGHT_TO_LEFT);
+    }
+  else
+    {
+      if (options.common_data.vertical)
+        gtk_progress_bar_set_orientation (GTK_PROGRESS_BAR (w), GTK_PROGRESS_BOTTOM_TO_TOP);
+      else
+        gtk_progress_bar_set_orientation (GTK_PROGRESS_BAR (w), GTK_PROGRESS_LEFT_TO_RIGHT);
+    }
+#endif
+
+  gtk_widget_show (b->label);
+  gtk_widget_show (b->bar);
+  nactive++;
+
+  return b;
+}
+
+/* hide bar and keep its slot for reuse */
+static void
+remove_bar (MultiBar * b)
+{
+  if (b->pulse_id)
+    {
+      g_source_remove (b->pulse_id);
+      b->pulse_id = 0;
+    }
+
+  g_hash_table_remove (bar_ids, b->id);
+  g_free (b->id);
+  b->id = NULL;
+
+  gtk_widget_hide (b->label);
+  gtk_widget_hide (b->bar);
+  nactive--;
+
+  /* reuse slots in order of their position */
+  free_bars = g_slist_insert_sorted (free_bars, b, (GCompareFunc) compare_slots);
+}
+
+static gboolean
+bars_complete (void)
+{
+  return (options.progress_data.autoclose && options.plug == -1 && ntracked > 0 && ncomplete == ntracked);
+}
+
+static gint
+get_bar_type (const gchar * str)
+{
+  if (strcasecmp (str, "NORM") == 0)
+    return YAD_PROGRESS_NORMAL;
+  else if (strcasecmp (str, "RTL") == 0)
+    return YAD_PROGRESS_RTL;
+  else if (strcasecmp (str, "PULSE") == 0)
+    return YAD_PROGRESS_PULSE;
+  else if (strcasecmp (str, "PERM") == 0)
+    return YAD_PROGRESS_PERM;
+  return -1;
+}
+
+/* add:ID:LABEL[:TYPE] */
+static void
+add_bar_cmd (gchar * str)
+{
+  MultiBar *b;
+  gchar *name, *t;
+  gint type = YAD_PROGRESS_NORMAL;
+
+  name = strchr (str, ':');
+  if (name == NULL || name == str)
+    {
+      g_printerr (_("Wrong bar specification: %s\n"), str);
+      return;
+    }
+  *name++ = '\0';
+
+  if (g_hash_table_lookup (bar_ids, str))
+    {
+      g_printerr (_("Bar with id %s already exists\n"), str);
+      return;
+    }
+
+  t = strrchr (name, ':');
+  if (t && (type = get_bar_type (t + 1)) >= 0)
+    *t = '\0';
+  else
+    type = YAD_PROGRESS_NORMAL;
+
+  compress_text (name);
+  b = add_bar (str, name, type);
+  if (b->tracked)
+    ntracked++;
+
+  set_scroll_size ();
+}
+
+/* remove:ID */
+static void
+remove_bar_cmd (gchar * str)
+{
+  MultiBar *b;
+
+  b = g_hash_table_lookup (bar_ids, str);
+  if (b == NULL)
+    return;
+
+  if (b->tracked)
+    {
+      ntracked--;
+      if (b->fraction >= 1.0)
+        ncomplete--;
+    }
+  remove_bar (b);
+
+  set_scroll_size ();
+}
+
+/* returns TRUE if dialog must be closed */
+static gboolean
+parse_line (gchar * line)
+{
+  MultiBar *b;
+  gchar *val;
+
+  if (strncmp (line, "add:", 4) == 0)
+    {
+      add_bar_cmd (line + 4);
+      return FALSE;
+    }
+  else if (strncmp (line, "remove:", 7) == 0)
+    {
+      remove_bar_cmd (line + 7);
+      return bars_complete ();
+    }
+
+  val = strchr (line, ':');
+  if (val == NULL)
+    return FALSE;
+
+  /* lookup bar by id without copying it */
+  *val = '\0';
+  b = g_hash_table_lookup (bar_ids, line);
+  *val++ = ':';
+  if (b == NULL)
+    return FALSE;
+
+  if (val[0] == '#')
+    {
+      /* We have a comment, so let's try to change the label */
+      compress_text (val + 1);
+      g_string_assign (b->text, val + 1);
+      b->new_text = TRUE;
+      mark_dirty (b);
+    }
+  else if (b->type == YAD_PROGRESS_PULSE)
+    {
+      b->pulse = TRUE;
+      mark_dirty (b);
+    }
+  else if (b->type == YAD_PROGRESS_PERM)
+    {
+      if (strncmp (val, "start", 5) == 0)
+        {
+          if (b->pulse_id == 0)
+            b->pulse_id = g_timeout_add (100, (GSourceFunc) pulsate_progress_bar, b->bar);
+        }
+      else if (strncmp (val, "stop", 4) == 0)
+        {
+          if (b->pulse_id > 0)
             {
-              if (err)
-                {
-                  g_printerr ("yad_multi_progress_handle_stdin(): %s\n", err->message);
-                  g_error_free (err);
-                  err = NULL;
-                }
-              /* stop handling */
-              g_io_channel_shutdown (channel, TRUE, NULL);
-              return FALSE;
+              g_source_remove (b->pulse_id);
+              b->pulse_id = 0;
             }
+        }
+    }
+  else if (g_ascii_isdigit (*val) || *val == '.')
+    {
+      /* Now try to convert the thing to a number */
+      set_fraction (b, g_ascii_strtod (val, NULL) / 100.0);
 
-          value = g_strsplit (string->str, ":", 2);
-          num = atoi (value[0]) - 1;
-          if (num < 0 || num > nbars - 1)
-            continue;
+      /* Check if all of progress bars reaches 100% */
+      return bars_complete ();
+    }
 
-          pb = GTK_PROGRESS_BAR (g_slist_nth_data (progress_bars, num));
-          b = (YadProgressBar *) g_slist_nth_data (options.multi_progress_data.bars, num);
+  return FALSE;
+}
 
-          if (value[1] && value[1][0] == '#')
-            {
-              gchar *match;
+/* stops processing of input when dialog must be closed */
+static gboolean
+input_line_cb (gchar * line, gpointer data)
+{
+  return !parse_line (line);
+}
 
-              /* We have a comment, so let's try to change the label */
-              match = g_strcompress (value[1] + 1);
-              strip_new_line (match);
-              gtk_progress_bar_set_text (pb, match);
-              g_free (match);
-            }
-          else
+/* called after each portion of input from stdin or socket */
+static void
+input_batch_cb (gboolean stopped, gpointer data)
+{
+  if (stopped)
+    {
+      if (render_timeout)
+        {
+          g_source_remove (render_timeout);
+          render_timeout = 0;
+        }
+      render_bars ();
+      yad_exit (options.data.def_resp);
+    }
+  else
+    schedule_render ();
+}
+
+/* reads shared memory counters once per frame. Counter N is used for bar with id N+1 */
+static gboolean
+sample_shm (gpointer data)
+{
+  gboolean changed = FALSE;
+  guint i;
+
+  for (i = 0; i < n_counters; i++)
+    {
+      MultiBar *b;
+      guint64 done, total;
+      gdouble val;
+      gchar id[16];
+
+      read_shm_counter (&shm_counters[i], &done, &total);
+      if (total == 0)
+        continue;
+
+      g_snprintf (id, sizeof (id), "%u", i + 1);
+      b = g_hash_table_lookup (bar_ids, id);
+      if (b == NULL || b->type == YAD_PROGRESS_PULSE || b->type == YAD_PROGRESS_PERM)
+        continue;
+
+      val = (done >= total) ? 1.0 : (gdouble) done / total;
+      if (val != b->fraction)
+        {
+          set_fraction (b, val);
+          changed = TRUE;
+        }
+    }
+
+  if (changed)
+    {
+      if (bars_complete ())
+        {
+          input_batch_cb (TRUE, NULL);
+          return FALSE;
+        }
+      render_bars ();
+    }
+
+  return TRUE;
+}
+
+static gboolean
+handle_stdin (GIOChannel * channel, GIOCondition condition, gpointer data)
+{
+  gchar buf[READ_BLOCK_SIZE];
+  gboolean eof = FALSE;
+  gint n;
+
+  /* drain all available input */
+  for (n = 0; n < MAX_READ_BLOCKS; n++)
+    {
+      GIOStatus status;
+      GError *err = NULL;
+      gsize len = 0;
+
+      status = g_io_channel_read_chars (channel, buf, READ_BLOCK_SIZE, &len, &err);
+      if (len > 0)
+        g_string_append_len (in_buf, buf, len);
+
+      if (status == G_IO_STATUS_AGAIN)
+        break;
+      if (status != G_IO_STATUS_NORMAL)
+        {
+          if (err)
             {
-              if (value[1] && b->type == YAD_PROGRESS_PULSE)
-                gtk_progress_bar_pulse (pb);
-              else if (value[1] && b->type == YAD_PROGRESS_PERM)
-                {
-                  guint id;
-                  
-                  if (strncmp (value[1], "start", 5) == 0)
-                    {
-                      id = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (pb), "id"));
-                      if (id == 0)
-                        {
-                          id = g_timeout_add (100, (GSourceFunc) pulsate_progress_bar, pb);
-                          g_object_set_data (G_OBJECT (pb), "id", GINT_TO_POINTER (id));
-                        }
-                    }
-                  else if (strncmp (value[1], "stop", 4) == 0)
-                    {
-                      id = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (pb), "id"));
-                      if (id > 0)
-                        {
-                          g_source_remove (id);
-                          g_object_set_data (G_OBJECT (pb), "id", GINT_TO_POINTER (0));
-                        }                      
-                    }                    
-                }
-              else
-                {
-                  if (!value[1] || !g_ascii_isdigit (*value[1]))
-                    continue;
-
-                  /* Now try to convert the thing to a number */
-                  percentage = atoi (value[1]);
-                  if (percentage >= 100)
-                    gtk_progress_bar_set_fraction (pb, 1.0);
-                  else
-                    gtk_progress_bar_set_fraction (pb, percentage / 100.0);
-
-                  /* Check if all of progress bars reaches 100% */
-                  if (options.progress_data.autoclose && options.plug == -1)
-                    {
-                      guint i;
-                      gboolean close = TRUE;
-                      gboolean need_close = FALSE;
-
-                      if (options.multi_progress_data.watch_bar > 0 && options.multi_progress_data.watch_bar <= nbars)
-                        {
-                          GtkProgressBar *cpb = GTK_PROGRESS_BAR (g_slist_nth_data (progress_bars,
-                                                                                    options.multi_progress_data.watch_bar - 1));
-
-                          need_close = TRUE;
-                          if (gtk_progress_bar_get_fraction (cpb) != 1.0)
-                            close = FALSE;
-                        }
-                      else
-                        {
-                          for (i = 0; i < nbars; i++)
-                            {
-                              GtkProgressBar *cpb = GTK_PROGRESS_BAR (g_slist_nth_data (progress_bars, i));
-                              YadProgressBar *cb = (YadProgressBar *) g_slist_nth_data (options.multi_progress_data.bars, i);
-
-                              if (cb->type != YAD_PROGRESS_PULSE)
-                                {
-                                  need_close = TRUE;
-                                  if (gtk_progress_bar_get_fraction (cpb) != 1.0)
-                                    {
-                                      close = FALSE;
-                                      break;
-                                    }
-                                }
-                            }
-                        }
-
-                      if (need_close && close)
-                        yad_exit (options.data.def_resp);
-                    }
-                }
+              g_printerr ("yad_multi_progress_handle_stdin(): %s\n", err->message);
+              g_error_free (err);
             }
+          eof = TRUE;
+          break;
         }
-      while (g_io_channel_get_buffer_condition (channel) == G_IO_IN);
-      g_string_free (string, TRUE);
     }
 
-  if ((condition != G_IO_IN) && (condition != G_IO_IN + G_IO_HUP))
+  if (!process_lines (in_buf, eof, input_line_cb, NULL))
+    {
+      input_batch_cb (TRUE, NULL);
+      return TRUE;
+    }
+
+  if (eof || ((condition & G_IO_HUP) && !(condition & G_IO_IN)))
     {
+      render_bars ();
       g_io_channel_shutdown (channel, TRUE, NULL);
       return FALSE;
     }
+
+  input_batch_cb (FALSE, NULL);
   return TRUE;
 }
 
+static void
+scroll_cb (GtkAdjustment * adj, gpointer data)
+{
+  schedule_render ();
+}
+
 GtkWidget *
 multi_progress_create_widget (GtkWidget * dlg)
 {
-  GtkWidget *table;
   GIOChannel *channel;
-  GSList *b;
-  gint i = 0;
+  GSList *l;
+  guint nbars, i = 0;
 
+  /* bars may be added later with commands */
   nbars = g_slist_length (options.multi_progress_data.bars);
-  if (nbars < 1)
-    return NULL;
 
 #if !GTK_CHECK_VERSION(3,0,0)
   if (options.common_data.vertical)
@@ -213,44 +716,40 @@ multi_progress_create_widget (GtkWidget * dlg)
   gtk_grid_set_column_spacing (GTK_GRID (table), 2);
 #endif
 
-  for (b = options.multi_progress_data.bars; b; b = b->next)
+  sw = gtk_scrolled_window_new (NULL, NULL);
+  gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (sw), GTK_SHADOW_NONE);
+  gtk_scrolled_window_add_with_viewport (GTK_SCROLLED_WINDOW (sw), table);
+  gtk_viewport_set_shadow_type (GTK_VIEWPORT (gtk_bin_get_child (GTK_BIN (sw))), GTK_SHADOW_NONE);
+  g_signal_connect (G_OBJECT (gtk_scrolled_window_get_hadjustment (GTK_SCROLLED_WINDOW (sw))),
+                    "value-changed", G_CALLBACK (scroll_cb), NULL);
+  g_signal_connect (G_OBJECT (gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (sw))),
+                    "value-changed", G_CALLBACK (scroll_cb), NULL);
+
+  bars = g_ptr_array_sized_new (nbars);
+  dirty_bars = g_ptr_array_sized_new (nbars);
+  bar_ids = g_hash_table_new (g_str_hash, g_str_equal);
+  watch_single = (options.multi_progress_data.watch_bar > 0 && options.multi_progress_data.watch_bar <= nbars);
+
+  for (l = options.multi_progress_data.bars; l; l = l->next)
     {
-      GtkWidget *l, *w;
-      YadProgressBar *p = (YadProgressBar *) b->data;
-
-      /* add label */
-      l = gtk_label_new (NULL);
-      if (options.data.no_markup)
-        gtk_label_set_text (GTK_LABEL (l), p->name);
-      else
-        gtk_label_set_markup (GTK_LABEL (l), p->name);
-      gtk_misc_set_alignment (GTK_MISC (l), options.common_data.align, 0.5);
-      if (options.common_data.vertical)
-#if !GTK_CHECK_VERSION(3,0,0)
-        gtk_table_attach (GTK_TABLE (table), l, i, i + 1, 1, 2, GTK_FILL, 0, 2, 2);
-#else
-        gtk_grid_attach (GTK_GRID (table), l, i, 1, 1, 1);
-#endif
-      else
-#if !GTK_CHECK_VERSION(3,0,0)
-        gtk_table_attach (GTK_TABLE (table), l, 0, 1, i, i + 1, GTK_FILL, 0, 2, 2);
-#else
-        gtk_grid_attach (GTK_GRID (table), l, 0, i, 1, 1);
-#endif
+      YadProgressBar *p = (YadProgressBar *) l->data;
+      MultiBar *b;
+      gchar *id;
 
-      /* add progress bar */
-      w = gtk_progress_bar_new ();
-      gtk_widget_set_name (w, "yad-progress-widget");
-#if GTK_CHECK_VERSION(3,0,0)
-      gtk_progress_bar_set_show_text (GTK_PROGRESS_BAR (w), TRUE);
-#endif
+      /* bars from command line are identified by their numbers */
+      id = g_strdup_printf ("%d", i + 1);
+      b = add_bar (id, p->name, p->type);
+      g_free (id);
 
       if (p->type != YAD_PROGRESS_PULSE)
         {
           if (options.extra_data && options.extra_data[i])
             {
               if (g_ascii_isdigit (*options.extra_data[i]))
-                gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (w), atoi (options.extra_data[i]) / 100.0);
+                {
+                  b->fraction = atoi (options.extra_data[i]) / 100.0;
+                  gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (b->bar), b->fraction);
+                }
             }
         }
       else
@@ -258,56 +757,55 @@ multi_progress_create_widget (GtkWidget * dlg)
           if (options.extra_data && options.extra_data[i])
             {
               if (g_ascii_isdigit (*options.extra_data[i]))
-                gtk_progress_bar_set_pulse_step (GTK_PROGRESS_BAR (w), atoi (options.extra_data[i]) / 100.0);
+                gtk_progress_bar_set_pulse_step (GTK_PROGRESS_BAR (b->bar), atoi (options.extra_data[i]) / 100.0);
             }
         }
 
-#if GTK_CHECK_VERSION(3,0,0)
-      gtk_progress_bar_set_inverted (GTK_PROGRESS_BAR (w), p->type == YAD_PROGRESS_RTL);
-      if (options.common_data.vertical)
-        gtk_orientable_set_orientation (GTK_ORIENTABLE (w), GTK_ORIENTATION_VERTICAL);
-#else
-      if (p->type == YAD_PROGRESS_RTL)
-        {
-          if (options.common_data.vertical)
-            gtk_progress_bar_set_orientation (GTK_PROGRESS_BAR (w), GTK_PROGRESS_TOP_TO_BOTTOM);
-          else
-            gtk_progress_bar_set_orientation (GTK_PROGRESS_BAR (w), GTK_PROGRESS_RIGHT_TO_LEFT);
-        }
-      else
-        {
-          if (options.common_data.vertical)
-            gtk_progress_bar_set_orientation (GTK_PROGRESS_BAR (w), GTK_PROGRESS_BOTTOM_TO_TOP);
-        }
-#endif
-      if (options.common_data.vertical)
-        {
-#if !GTK_CHECK_VERSION(3,0,0)
-          gtk_table_attach (GTK_TABLE (table), w, i, i + 1, 0, 1, 0, GTK_FILL | GTK_EXPAND, 2, 2);
-#else
-          gtk_grid_attach (GTK_GRID (table), w, i, 0, 1, 1);
-          gtk_widget_set_vexpand (w, TRUE);
-#endif
-        }
-      else
+      i++;
+    }
+
+  /* setup bars for auto-close */
+  if (watch_single)
+    {
+      MultiBar *b = g_ptr_array_index (bars, options.multi_progress_data.watch_bar - 1);
+      b->tracked = TRUE;
+    }
+  for (i = 0; i < nbars; i++)
+    {
+      MultiBar *b = g_ptr_array_index (bars, i);
+      if (b->tracked)
         {
-#if !GTK_CHECK_VERSION(3,0,0)
-          gtk_table_attach (GTK_TABLE (table), w, 1, 2, i, i + 1, GTK_FILL | GTK_EXPAND, 0, 2, 2);
-#else
-          gtk_grid_attach (GTK_GRID (table), w, 1, i, 1, 1);
-          gtk_widget_set_hexpand (w, TRUE);
-#endif
+          ntracked++;
+          if (b->fraction >= 1.0)
+            ncomplete++;
         }
+    }
 
-      progress_bars = g_slist_append (progress_bars, w);
+  set_scroll_size ();
 
-      i++;
+  if (options.progress_data.shm)
+    {
+      n_counters = MAX (nbars, 1);
+      shm_counters = open_shm_counters (options.progress_data.shm, n_counters);
+      if (shm_counters)
+        g_timeout_add (FRAME_INTERVAL, sample_shm, NULL);
     }
 
-  channel = g_io_channel_unix_new (0);
-  g_io_channel_set_encoding (channel, NULL, NULL);
-  g_io_channel_set_flags (channel, G_IO_FLAG_NONBLOCK, NULL);
-  g_io_add_watch (channel, G_IO_IN | G_IO_HUP, handle_stdin, dlg);
+  if (options.common_data.socket)
+    {
+      /* data from all of clients are merged together */
+      if (!listen_socket (options.common_data.socket, input_line_cb, input_batch_cb, NULL))
+        exit (-1);
+    }
+  else
+    {
+      in_buf = g_string_new (NULL);
+
+      channel = g_io_channel_unix_new (0);
+      g_io_channel_set_encoding (channel, NULL, NULL);
+      g_io_channel_set_flags (channel, G_IO_FLAG_NONBLOCK, NULL);
+      g_io_add_watch (channel, G_IO_IN | G_IO_HUP, handle_stdin, dlg);
+    }
 
-  return table;
+  return sw;
 }
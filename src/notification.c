@@ -21,6 +21,7 @@
 #include <fcntl.h>
 #include <time.h>
 #include <string.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
 
@@ -40,7 +41,22 @@ static gchar *action = NULL;
 static GSList *menu_data = NULL;
 
 static gint exit_code;
-static gint icon_size = 16;
+
+#define READ_BLOCK_SIZE 4096
+#define MAX_READ_BLOCKS 64
+#define FRAME_INTERVAL 40       /* ms */
+
+static GString *in_buf = NULL;
+
+/* icon and tooltip changes are applied once per frame */
+static gboolean icon_dirty = FALSE;
+static gchar *pending_tooltip = NULL;
+static guint render_timeout = 0;
+
+/* animation */
+static gchar **anim_frames = NULL;
+static guint anim_frame = 0;
+static guint anim_timeout = 0;
 
 static void
 free_menu_data (gpointer data, gpointer udata)
@@ -99,25 +115,21 @@ timeout_cb (gpointer data)
 }
 
 static void
-set_icon (void)
+set_icon_from (const gchar * name)
 {
-  GdkPixbuf *pixbuf;
-  GError *err = NULL;
+  struct stat st;
 
-  if (icon == NULL)
+  if (name == NULL)
     {
       gtk_status_icon_set_from_icon_name (status_icon, "yad");
       return;
     }
 
-  if (g_file_test (icon, G_FILE_TEST_EXISTS))
+  if (stat (name, &st) == 0)
     {
-      pixbuf = gdk_pixbuf_new_from_file_at_scale (icon, icon_size, icon_size, TRUE, &err);
-      if (err)
-        {
-          g_printerr (_("Could not load notification icon '%s': %s\n"), icon, err->message);
-          g_clear_error (&err);
-        }
+      /* decoded icons are kept in common cache until file changes */
+      GdkPixbuf *pixbuf = get_icon_pixbuf ((gchar *) name, YAD_SMALL_ICON);
+
       if (pixbuf)
         {
           gtk_status_icon_set_from_pixbuf (status_icon, pixbuf);
@@ -127,7 +139,66 @@ set_icon (void)
         gtk_status_icon_set_from_icon_name (status_icon, "yad");
     }
   else
-    gtk_status_icon_set_from_icon_name (status_icon, icon);
+    gtk_status_icon_set_from_icon_name (status_icon, name);
+}
+
+static void
+set_icon (void)
+{
+  set_icon_from (icon);
+}
+
+static gboolean
+animate_cb (gpointer data)
+{
+  if (gtk_status_icon_get_visible (status_icon) && gtk_status_icon_is_embedded (status_icon))
+    set_icon_from (anim_frames[anim_frame]);
+
+  anim_frame++;
+  if (anim_frames[anim_frame] == NULL)
+    anim_frame = 0;
+
+  return TRUE;
+}
+
+static void
+stop_animation (void)
+{
+  if (anim_timeout)
+    {
+      g_source_remove (anim_timeout);
+      anim_timeout = 0;
+    }
+  g_strfreev (anim_frames);
+  anim_frames = NULL;
+}
+
+/* value is INTERVAL|ICON1|ICON2|... */
+static void
+start_animation (gchar * value)
+{
+  gchar **vals;
+  guint interval;
+
+  stop_animation ();
+
+  vals = g_strsplit (value, options.common_data.separator, -1);
+  if (vals[0] == NULL || vals[1] == NULL || (interval = atoi (vals[0])) == 0)
+    {
+      g_printerr (_("Wrong animation specification: %s\n"), value);
+      g_strfreev (vals);
+      set_icon ();
+      return;
+    }
+
+  /* skip interval */
+  g_free (vals[0]);
+  memmove (vals, vals + 1, g_strv_length (vals) * sizeof (gchar *));
+
+  anim_frames = vals;
+  anim_frame = 0;
+  animate_cb (NULL);
+  anim_timeout = g_timeout_add (interval, animate_cb, NULL);
 }
 
 static gboolean
@@ -195,7 +266,7 @@ popup_menu_cb (GtkStatusIcon * icon, guint button, guint activate_time, gpointer
         {
           if (d->icon)
             {
-              GdkPixbuf *pb = get_pixbuf (d->icon, YAD_SMALL_ICON);
+              GdkPixbuf *pb = get_icon_pixbuf (d->icon, YAD_SMALL_ICON);
               item = gtk_image_menu_item_new_with_mnemonic (d->name);
               if (pb)
                 {
@@ -224,132 +295,184 @@ popup_menu_cb (GtkStatusIcon * icon, guint button, guint activate_time, gpointer
 }
 
 static gboolean
-handle_stdin (GIOChannel * channel, GIOCondition condition, gpointer data)
+render_updates (gpointer data)
 {
-  if ((condition & G_IO_IN) != 0)
-    {
-      GString *string;
-      GError *err = NULL;
+  if (icon_dirty && gtk_status_icon_get_visible (status_icon) && gtk_status_icon_is_embedded (status_icon))
+    set_icon ();
+  icon_dirty = FALSE;
 
-      string = g_string_new (NULL);
-      while (channel->is_readable == FALSE);
+  if (pending_tooltip)
+    {
+      if (!options.data.no_markup)
+        gtk_status_icon_set_tooltip_markup (status_icon, pending_tooltip);
+      else
+        gtk_status_icon_set_tooltip_text (status_icon, pending_tooltip);
+      g_free (pending_tooltip);
+      pending_tooltip = NULL;
+    }
 
-      do
-        {
-          gint status;
-          gchar *command = NULL, *value = NULL, **args;
+  render_timeout = 0;
+  return FALSE;
+}
 
-          do
-            {
-              status = g_io_channel_read_line_string (channel, string, NULL, &err);
+static void
+schedule_render ()
+{
+  if (render_timeout == 0)
+    render_timeout = g_timeout_add (FRAME_INTERVAL, render_updates, NULL);
+}
 
-              while (gdk_events_pending ())
-                gtk_main_iteration ();
-            }
-          while (status == G_IO_STATUS_AGAIN);
+static gboolean
+input_line_cb (gchar * line, gpointer data)
+{
+  gchar *command = NULL, *value = NULL, **args;
+  gboolean res = TRUE;
 
-          if (status != G_IO_STATUS_NORMAL)
-            {
-              if (err)
-                {
-                  g_printerr ("yad_notification_handle_stdin(): %s\n", err->message);
-                  g_error_free (err);
-                  err = NULL;
-                }
-              /* stop handling but not exit */
-              g_io_channel_shutdown (channel, TRUE, NULL);
-              return FALSE;
-            }
+  if (!line[0])
+    return TRUE;
 
-          strip_new_line (string->str);
-          if (!string->str[0])
-            continue;
+  args = g_strsplit (line, ":", 2);
+  command = g_strdup (args[0]);
+  if (args[1])
+    value = g_strdup (args[1]);
+  g_strfreev (args);
+  if (value)
+    g_strstrip (value);
 
-          args = g_strsplit (string->str, ":", 2);
-          command = g_strdup (args[0]);
-          if (args[1])
-            value = g_strdup (args[1]);
-          g_strfreev (args);
-          if (value)
-            g_strstrip (value);
+  if (!g_ascii_strcasecmp (command, "icon") && value)
+    {
+      stop_animation ();
 
-          if (!g_ascii_strcasecmp (command, "icon") && value)
-            {
-              g_free (icon);
-              icon = g_strdup (value);
+      g_free (icon);
+      icon = g_strdup (value);
 
-              if (gtk_status_icon_get_visible (status_icon) && gtk_status_icon_is_embedded (status_icon))
-                set_icon ();
-            }
-          else if (!g_ascii_strcasecmp (command, "tooltip"))
-            {
-              if (g_utf8_validate (value, -1, NULL))
-                {
-                  gchar *message = g_strcompress (value);
-                  if (!options.data.no_markup)
-                    gtk_status_icon_set_tooltip_markup (status_icon, message);
-                  else
-                    gtk_status_icon_set_tooltip_text (status_icon, message);
-                  g_free (message);
-                }
-              else
-                g_printerr (_("Invalid UTF-8 in tooltip!\n"));
-            }
-          else if (!g_ascii_strcasecmp (command, "visible"))
-            {
+      icon_dirty = TRUE;
+      schedule_render ();
+    }
+  else if (!g_ascii_strcasecmp (command, "animate"))
+    {
+      if (value && *value)
+        {
+          start_animation (value);
+          /* animation sets icon by itself */
+          icon_dirty = FALSE;
+        }
+      else
+        {
+          stop_animation ();
+          icon_dirty = TRUE;
+          schedule_render ();
+        }
+    }
+  else if (!g_ascii_strcasecmp (command, "tooltip") && value)
+    {
+      if (g_utf8_validate (value, -1, NULL))
+        {
+          g_free (pending_tooltip);
+          pending_tooltip = g_strcompress (value);
+          schedule_render ();
+        }
+      else
+        g_printerr (_("Invalid UTF-8 in tooltip!\n"));
+    }
+  else if (!g_ascii_strcasecmp (command, "visible") && value)
+    {
 #if !GTK_CHECK_VERSION(2,22,0)
-              if (!g_ascii_strcasecmp (value, "blink"))
-                {
-                  gboolean state = gtk_status_icon_get_blinking (status_icon);
-                  gtk_status_icon_set_blinking (status_icon, !state);
-                }
-              else
+      if (!g_ascii_strcasecmp (value, "blink"))
+        {
+          gboolean state = gtk_status_icon_get_blinking (status_icon);
+          gtk_status_icon_set_blinking (status_icon, !state);
+        }
+      else
 #endif
-              if (!g_ascii_strcasecmp (value, "false"))
-                {
-                  gtk_status_icon_set_visible (status_icon, FALSE);
+      if (!g_ascii_strcasecmp (value, "false"))
+        {
+          gtk_status_icon_set_visible (status_icon, FALSE);
 #if !GTK_CHECK_VERSION(2,22,0)
-                  gtk_status_icon_set_blinking (status_icon, FALSE);
+          gtk_status_icon_set_blinking (status_icon, FALSE);
 #endif
-                }
-              else
-                {
-                  gtk_status_icon_set_visible (status_icon, TRUE);
+        }
+      else
+        {
+          gtk_status_icon_set_visible (status_icon, TRUE);
 #if !GTK_CHECK_VERSION(2,22,0)
-                  gtk_status_icon_set_blinking (status_icon, FALSE);
+          gtk_status_icon_set_blinking (status_icon, FALSE);
 #endif
-                }
-            }
-          else if (!g_ascii_strcasecmp (command, "action"))
-            {
-              g_free (action);
-              if (value)
-                action = g_strdup (value);
-            }
-          else if (!g_ascii_strcasecmp (command, "quit"))
-            {
-              exit_code = YAD_RESPONSE_OK;
-              gtk_main_quit ();
-            }
-          else if (!g_ascii_strcasecmp (command, "menu"))
+        }
+    }
+  else if (!g_ascii_strcasecmp (command, "action"))
+    {
+      g_free (action);
+      if (value)
+        action = g_strdup (value);
+    }
+  else if (!g_ascii_strcasecmp (command, "quit"))
+    {
+      exit_code = YAD_RESPONSE_OK;
+      gtk_main_quit ();
+      res = FALSE;
+    }
+  else if (!g_ascii_strcasecmp (command, "menu"))
+    {
+      if (value)
+        parse_menu_str (value);
+    }
+  else
+    g_printerr (_("Unknown command '%s'\n"), command);
+
+  g_free (command);
+  g_free (value);
+
+  return res;
+}
+
+static gboolean
+handle_stdin (GIOChannel * channel, GIOCondition condition, gpointer data)
+{
+  gchar buf[READ_BLOCK_SIZE];
+  gboolean eof = FALSE, hup;
+  gint n;
+
+  for (n = 0; n < MAX_READ_BLOCKS; n++)
+    {
+      GIOStatus status;
+      GError *err = NULL;
+      gsize len = 0;
+
+      status = g_io_channel_read_chars (channel, buf, READ_BLOCK_SIZE, &len, &err);
+      if (len > 0)
+        g_string_append_len (in_buf, buf, len);
+
+      if (status == G_IO_STATUS_AGAIN)
+        break;
+      if (status != G_IO_STATUS_NORMAL)
+        {
+          if (err)
             {
-              if (value)
-                parse_menu_str (value);
+              g_printerr ("yad_notification_handle_stdin(): %s\n", err->message);
+              g_error_free (err);
             }
-          else
-            g_printerr (_("Unknown command '%s'\n"), command);
-
-          g_free (command);
-          g_free (value);
+          eof = TRUE;
+          break;
         }
-      while (g_io_channel_get_buffer_condition (channel) == G_IO_IN);
-      g_string_free (string, TRUE);
     }
+  hup = (condition & G_IO_HUP) != 0;
+  if (hup && !(condition & G_IO_IN))
+    eof = TRUE;
 
-  if ((condition & G_IO_HUP) != 0)
+  if (!process_lines (in_buf, eof, input_line_cb, NULL))
     {
       g_io_channel_shutdown (channel, TRUE, NULL);
-      gtk_main_quit ();
+      return FALSE;
+    }
+
+  if (eof || hup)
+    {
+      g_io_channel_shutdown (channel, TRUE, NULL);
+      /* end of data or read error only stops handling. Hang up exits,
+       * unless socket clients still may send commands */
+      if (hup && !options.common_data.socket)
+        gtk_main_quit ();
       return FALSE;
     }
 
@@ -390,8 +513,12 @@ yad_notification_run ()
   if (options.notification_data.middle)
     g_signal_connect (status_icon, "button-press-event", G_CALLBACK (middle_quit_cb), NULL);
 
+  if (options.common_data.socket && !listen_socket (options.common_data.socket, input_line_cb, NULL, NULL))
+    exit (-1);
+
   if (options.common_data.listen)
     {
+      in_buf = g_string_sized_new (READ_BLOCK_SIZE);
       channel = g_io_channel_unix_new (0);
       if (channel)
         {
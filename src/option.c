@@ -42,6 +42,8 @@ static gboolean set_expander (const gchar *, const gchar *, gpointer, GError **)
 static gboolean set_orient (const gchar *, const gchar *, gpointer, GError **);
 static gboolean set_print_type (const gchar *, const gchar *, gpointer, GError **);
 static gboolean set_progress_log (const gchar *, const gchar *, gpointer, GError **);
+static gboolean set_progress_eta (const gchar *, const gchar *, gpointer, GError **);
+static gboolean set_watch_pid (const gchar *, const gchar *, gpointer, GError **);
 static gboolean set_size (const gchar *, const gchar *, gpointer, GError **);
 static gboolean set_posx (const gchar *, const gchar *, gpointer, GError **);
 static gboolean set_posy (const gchar *, const gchar *, gpointer, GError **);
@@ -185,6 +187,8 @@ static GOptionEntry common_options[] = {
     N_("Set command handler"), N_("CMD") },
   { "listen", 0, 0, G_OPTION_ARG_NONE, &options.common_data.listen,
     N_("Listen for data on stdin"), NULL },
+  { "socket", 0, 0, G_OPTION_ARG_FILENAME, &options.common_data.socket,
+    N_("Read data from clients of unix socket"), N_("PATH") },
   { "separator", 0, 0, G_OPTION_ARG_STRING, &options.common_data.separator,
     N_("Set common separator character"), N_("SEPARATOR") },
   { "item-separator", 0, 0, G_OPTION_ARG_STRING, &options.common_data.item_separator,
@@ -197,6 +201,8 @@ static GOptionEntry common_options[] = {
     N_("Quote dialogs output"), NULL },
   { "num-output", 0, 0, G_OPTION_ARG_NONE, &options.common_data.num_output,
     N_("Output number instead of text for combo-box"), NULL },
+  { "encoding", 0, 0, G_OPTION_ARG_STRING, &options.common_data.encoding,
+    N_("Set encoding of input stream data"), N_("ENCODING") },
   { "fontname", 0, 0, G_OPTION_ARG_STRING, &options.common_data.font,
     N_("Specify font name to use"), N_("FONTNAME") },
   { "multiple", 0, 0, G_OPTION_ARG_NONE, &options.common_data.multi,
@@ -356,8 +362,6 @@ static GOptionEntry html_options[] = {
     N_("Print clicked uri to stdout"), NULL },
   { "mime", 0, 0, G_OPTION_ARG_STRING, &options.html_data.mime,
     N_("Set mime type of input stream data"), N_("TYPE") },
-  { "encoding", 0, 0, G_OPTION_ARG_STRING, &options.html_data.encoding,
-    N_("Set encoding of input stream data"), N_("ENCODING") },
   { "uri-handler", 0, 0, G_OPTION_ARG_STRING, &options.html_data.uri_cmd,
     N_("Set external handler for clicked uri"), N_("CMD") },
   { "user-agent", 0, 0, G_OPTION_ARG_STRING, &options.html_data.user_agent,
@@ -388,6 +392,8 @@ static GOptionEntry icons_options[] = {
     N_("Sort items in descending order"), NULL },
   { "single-click", 0, 0, G_OPTION_ARG_NONE, &options.icons_data.single_click,
     N_("Activate items by single click"), NULL },
+  { "grid", 0, 0, G_OPTION_ARG_NONE, &options.icons_data.grid,
+    N_("Use light-weight grid for large sets of items"), NULL },
 #ifdef HAVE_GIO
   { "monitor", 0, 0, G_OPTION_ARG_NONE, &options.icons_data.monitor,
     N_("Watch fot changes in directory"), NULL },
@@ -471,6 +477,8 @@ static GOptionEntry multi_progress_options[] = {
   { "auto-kill", 0, G_OPTION_FLAG_NOALIAS, G_OPTION_ARG_NONE, &options.progress_data.autokill,
     N_("Kill parent process if cancel button is pressed"), NULL },
 #endif
+  { "shm", 0, G_OPTION_FLAG_NOALIAS, G_OPTION_ARG_FILENAME, &options.progress_data.shm,
+    N_("Read progress from counters in shared memory"), N_("NAME") },
   { NULL }
 };
 
@@ -556,6 +564,22 @@ static GOptionEntry progress_options[] = {
     N_("Place log window above progress bar"), NULL },
   { "log-height", 0, 0, G_OPTION_ARG_INT, &options.progress_data.log_height,
     N_("Height of log window"), NULL },
+  { "log-lines", 0, 0, G_OPTION_ARG_INT, &options.progress_data.log_lines,
+    N_("Maximum number of lines in log window"), N_("NUMBER") },
+  { "log-file", 0, 0, G_OPTION_ARG_FILENAME, &options.progress_data.log_file,
+    N_("Write full log to file"), N_("FILENAME") },
+  { "eta", 0, G_OPTION_FLAG_OPTIONAL_ARG, G_OPTION_ARG_CALLBACK, set_progress_eta,
+    N_("Show rate and remaining time in progress bar"), N_("[FORMAT]") },
+  { "shm", 0, G_OPTION_FLAG_NOALIAS, G_OPTION_ARG_FILENAME, &options.progress_data.shm,
+    N_("Read progress from counters in shared memory"), N_("NAME") },
+  { "pipe", 0, 0, G_OPTION_ARG_NONE, &options.progress_data.pipe,
+    N_("Copy stdin to stdout and show amount of passed data"), NULL },
+  { "watch-file", 0, 0, G_OPTION_ARG_FILENAME, &options.progress_data.watch_file,
+    N_("Show progress of growing file"), N_("FILENAME") },
+  { "target-size", 0, 0, G_OPTION_ARG_INT64, &options.progress_data.size,
+    N_("Set expected size of piped data, watched file or process i/o"), N_("SIZE") },
+  { "watch-pid", 0, 0, G_OPTION_ARG_CALLBACK, set_watch_pid,
+    N_("Show progress of process i/o and close when process exits"), N_("PID[:read|write]") },
   { NULL }
 };
 
@@ -574,6 +598,8 @@ static GOptionEntry scale_options[] = {
     N_("Set paging size"), N_("VALUE") },
   { "print-partial", 0, 0, G_OPTION_ARG_NONE, &options.scale_data.print_partial,
     N_("Print partial values"), NULL },
+  { "partial-interval", 0, 0, G_OPTION_ARG_INT, &options.scale_data.partial_interval,
+    N_("Print partial values not more often than once per interval"), N_("MS") },
   { "hide-value", 0, 0, G_OPTION_ARG_NONE, &options.scale_data.hide_value,
     N_("Hide value"), NULL },
   { "invert", 0, 0, G_OPTION_ARG_NONE, &options.scale_data.invert,
@@ -604,6 +630,18 @@ static GOptionEntry text_options[] = {
     N_("Make URI clickable"), NULL },
   { "uri-color", 0, 0, G_OPTION_ARG_STRING, &options.text_data.uri_color,
     N_("Use specified color for links"), N_("COLOR") },
+  { "replace-invalid", 0, 0, G_OPTION_ARG_NONE, &options.text_data.replace_invalid,
+    N_("Replace invalid characters in input with U+FFFD"), NULL },
+  { "ansi", 0, 0, G_OPTION_ARG_NONE, &options.text_data.ansi,
+    N_("Parse ANSI color escape sequences"), NULL },
+  { "max-line", 0, 0, G_OPTION_ARG_INT, &options.text_data.max_line,
+    N_("Split lines longer than specified number of characters"), N_("NUMBER") },
+  { "truncate-lines", 0, 0, G_OPTION_ARG_NONE, &options.text_data.truncate_lines,
+    N_("Truncate long lines instead of splitting"), NULL },
+#ifdef HAVE_GIO
+  { "follow", 0, 0, G_OPTION_ARG_NONE, &options.text_data.follow,
+    N_("Watch for appended data in file"), NULL },
+#endif
   { NULL }
 };
 
@@ -1107,6 +1145,46 @@ set_progress_log (const gchar * option_name, const gchar * value, gpointer data,
   return TRUE;
 }
 
+static gboolean
+set_progress_eta (const gchar * option_name, const gchar * value, gpointer data, GError ** err)
+{
+  if (value)
+    options.progress_data.eta = g_strdup (value);
+  else
+    /* xgettext: no-c-format */
+    options.progress_data.eta = _("%p% (%E left)");
+
+  return TRUE;
+}
+
+static gboolean
+set_watch_pid (const gchar * option_name, const gchar * value, gpointer data, GError ** err)
+{
+  gchar *end;
+  glong pid;
+
+  pid = strtol (value, &end, 10);
+  if (end == value || pid <= 0 || pid > G_MAXINT)
+    {
+      g_printerr (_("Invalid process id: %s\n"), value);
+      return TRUE;
+    }
+
+  if (*end == ':' && strcasecmp (end + 1, "write") == 0)
+    options.progress_data.watch_write = TRUE;
+  else if (*end == ':' && strcasecmp (end + 1, "read") == 0)
+    options.progress_data.watch_write = FALSE;
+  else if (*end)
+    {
+      g_printerr (_("Invalid process id: %s\n"), value);
+      return TRUE;
+    }
+
+  options.progress_data.watch_pid = pid;
+
+  return TRUE;
+}
+
 static gboolean
 set_size (const gchar * option_name, const gchar * value, gpointer data, GError ** err)
 {
@@ -1444,10 +1522,12 @@ yad_options_init (void)
   options.common_data.vertical = FALSE;
   options.common_data.align = 0.0;
   options.common_data.listen = FALSE;
+  options.common_data.socket = NULL;
   options.common_data.preview = FALSE;
   options.common_data.show_hidden = FALSE;
   options.common_data.quoted_output = FALSE;
   options.common_data.num_output = FALSE;
+  options.common_data.encoding = NULL;
   options.common_data.filters = NULL;
   options.common_data.key = -1;
   options.common_data.complete = YAD_COMPLETE_SIMPLE;
@@ -1518,7 +1598,6 @@ yad_options_init (void)
   options.html_data.browser = FALSE;
   options.html_data.print_uri = FALSE;
   options.html_data.mime = NULL;
-  options.html_data.encoding = NULL;
   options.html_data.uri_cmd = NULL;
   options.html_data.user_agent = "YAD-Webkit (" VERSION ")";
   options.html_data.user_style = NULL;
@@ -1533,6 +1612,7 @@ yad_options_init (void)
   options.icons_data.sort_by_name = FALSE;
   options.icons_data.descend = FALSE;
   options.icons_data.single_click = FALSE;
+  options.icons_data.grid = FALSE;
 #ifdef HAVE_GIO
   options.icons_data.monitor = FALSE;
 #endif
@@ -1606,6 +1686,15 @@ yad_options_init (void)
   options.progress_data.log_expanded = FALSE;
   options.progress_data.log_on_top = FALSE;
   options.progress_data.log_height = -1;
+  options.progress_data.log_lines = 10000;
+  options.progress_data.log_file = NULL;
+  options.progress_data.eta = NULL;
+  options.progress_data.shm = NULL;
+  options.progress_data.pipe = FALSE;
+  options.progress_data.size = 0;
+  options.progress_data.watch_file = NULL;
+  options.progress_data.watch_pid = 0;
+  options.progress_data.watch_write = FALSE;
 
   /* Initialize scale data */
   options.scale_data.value = 0;
@@ -1614,6 +1703,7 @@ yad_options_init (void)
   options.scale_data.step = 1;
   options.scale_data.page = -1;
   options.scale_data.print_partial = FALSE;
+  options.scale_data.partial_interval = 0;
   options.scale_data.hide_value = FALSE;
   options.scale_data.have_value = FALSE;
   options.scale_data.invert = FALSE;
@@ -1628,6 +1718,13 @@ yad_options_init (void)
   options.text_data.margins = 0;
   options.text_data.hide_cursor = TRUE;
   options.text_data.uri_color = "blue";
+  options.text_data.replace_invalid = FALSE;
+  options.text_data.ansi = FALSE;
+  options.text_data.max_line = 0;
+  options.text_data.truncate_lines = FALSE;
+#ifdef HAVE_GIO
+  options.text_data.follow = FALSE;
+#endif
 
 #ifdef HAVE_SOURCEVIEW
   /* Initialize sourceview data */
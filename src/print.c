@@ -88,12 +88,30 @@ draw_header (GtkPrintContext * cnt, gint pn, gint pc)
 static void
 begin_print_text (GtkPrintOperation * op, GtkPrintContext * cnt, gpointer data)
 {
-  gchar *buf;
+  gchar *buf = NULL;
   gint i = 0;
   gdouble ph;
+#ifdef HAVE_GIO
+  GInputStream *stream;
+#endif
 
   /* load file */
-  g_file_get_contents (options.common_data.uri, &buf, NULL, NULL);
+#ifdef HAVE_GIO
+  stream = open_compressed_file (options.common_data.uri);
+  if (stream)
+    {
+      GString *str = g_string_new (NULL);
+      gchar chunk[65536];
+      gssize count;
+
+      while ((count = g_input_stream_read (stream, chunk, sizeof (chunk), NULL, NULL)) > 0)
+        g_string_append_len (str, chunk, count);
+      g_object_unref (stream);
+      buf = g_string_free (str, FALSE);
+    }
+  else
+#endif
+    g_file_get_contents (options.common_data.uri, &buf, NULL, NULL);
   text = g_strsplit (buf, "\n", 0);
   g_free (buf);
 
@@ -17,18 +17,69 @@
  * Copyright (C) 2008-2017, Victor Ananjevsky <ananasik@gmail.com>
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1
+#endif
+
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <signal.h>
+#include <sys/stat.h>
 
 #include "yad.h"
 
+#define READ_BLOCK_SIZE 4096
+#define MAX_READ_BLOCKS 64
+#define FRAME_INTERVAL 40       /* minimal interval between redraws in ms */
+#define RATE_INTERVAL 0.5       /* minimal sampling interval for rate estimation in seconds */
+#define RATE_SMOOTHING 0.3      /* weight of the new sample in rate average */
+#define PIPE_CHUNK 65536
+#define WATCH_INTERVAL 100      /* sampling interval for watched file or process in ms */
+#define LOG_TRIM_RATIO 10       /* old log lines are removed by batches of 1/LOG_TRIM_RATIO of limit */
+#define LOG_FILE_BUFFER 65536
+
 static GtkWidget *progress_bar;
 static GtkWidget *progress_log;
 static GtkTextBuffer *log_buffer;
+static GtkTextMark *log_end;
+
+static guint pulsate_timeout = 0;
+
+/* pending state, applied to widgets once per frame */
+static GString *in_buf = NULL;
+static GString *pending_log = NULL;
+static guint pending_lines = 0;
+static FILE *log_file = NULL;
+static gchar *pending_text = NULL;
+static gdouble pending_fraction = -1.0;
+static guint render_timeout = 0;
+
+/* throughput estimation */
+static GTimer *eta_timer = NULL;
+static gdouble cur_done = 0.0;
+static gdouble cur_total = 100.0;
+static gdouble sample_done = 0.0;
+static gdouble sample_time = 0.0;
+static gdouble rate = 0.0;
+static gchar *eta_label = NULL;
+static gboolean eta_dirty = FALSE;
+
+/* progress counter in shared memory */
+static YadShmCounter *shm_counter = NULL;
+static guint watch_source = 0;
+static guint64 shm_done = 0;
+static guint64 shm_total = 0;
+
+/* pass-through mode */
+static YadShmCounter pipe_counter;
+static volatile gint pipe_finished = 0;
+
+static void schedule_render (void);
 
 static gboolean
 pulsate_progress_bar (gpointer user_data)
@@ -37,116 +88,624 @@ pulsate_progress_bar (gpointer user_data)
   return TRUE;
 }
 
+static void
+update_rate (gdouble done, gdouble total)
+{
+  gdouble t = g_timer_elapsed (eta_timer, NULL);
+
+  if (total != cur_total || done < sample_done)
+    {
+      /* new job, restart estimation */
+      sample_done = done;
+      sample_time = t;
+      rate = 0.0;
+    }
+  else if (t - sample_time >= RATE_INTERVAL)
+    {
+      gdouble r = (done - sample_done) / (t - sample_time);
+
+      rate = (rate > 0.0) ? RATE_SMOOTHING * r + (1.0 - RATE_SMOOTHING) * rate : r;
+      sample_done = done;
+      sample_time = t;
+    }
+
+  cur_done = done;
+  cur_total = total;
+  eta_dirty = TRUE;
+}
+
+static void
+append_time (GString * str, gdouble sec)
+{
+  gulong s;
+
+  if (sec < 0)
+    {
+      g_string_append (str, "--:--");
+      return;
+    }
+
+  s = (gulong) (sec + 0.5);
+  if (s >= 3600)
+    g_string_append_printf (str, "%lu:%02lu:%02lu", s / 3600, (s / 60) % 60, s % 60);
+  else
+    g_string_append_printf (str, "%lu:%02lu", s / 60, s % 60);
+}
+
+static gchar *
+format_eta (void)
+{
+  GString *str;
+  const gchar *p;
+
+  str = g_string_new (NULL);
+  for (p = options.progress_data.eta; *p; p++)
+    {
+      gchar *sz;
+
+      if (*p != '%' || !p[1])
+        {
+          g_string_append_c (str, *p);
+          continue;
+        }
+
+      switch (*++p)
+        {
+        case 'p':
+          g_string_append_printf (str, "%.0f", cur_total > 0 ? cur_done / cur_total * 100.0 : 0.0);
+          break;
+        case 'd':
+          g_string_append_printf (str, "%.0f", cur_done);
+          break;
+        case 't':
+          g_string_append_printf (str, "%.0f", cur_total);
+          break;
+        case 'r':
+          g_string_append_printf (str, "%.1f", rate);
+          break;
+        case 'b':
+#if GLIB_CHECK_VERSION(2,30,0)
+          sz = g_format_size ((guint64) rate);
+#else
+          sz = g_format_size_for_display ((goffset) rate);
+#endif
+          g_string_append (str, sz);
+          g_free (sz);
+          break;
+        case 'e':
+          append_time (str, g_timer_elapsed (eta_timer, NULL));
+          break;
+        case 'E':
+          if (cur_total <= 0)
+            append_time (str, -1);
+          else if (cur_done >= cur_total)
+            append_time (str, 0);
+          else
+            append_time (str, rate > 0.0 ? (cur_total - cur_done) / rate : -1);
+          break;
+        case 'l':
+          if (eta_label)
+            g_string_append (str, eta_label);
+          break;
+        case '%':
+          g_string_append_c (str, '%');
+          break;
+        default:
+          /* not a format sequence, keep it as is */
+          g_string_append_c (str, '%');
+          g_string_append_c (str, *p);
+          break;
+        }
+    }
+
+  return g_string_free (str, FALSE);
+}
+
 static gboolean
-handle_stdin (GIOChannel * channel, GIOCondition condition, gpointer data)
+eta_tick (gpointer data)
+{
+  /* keep elapsed and remaining time up to date when no input comes */
+  eta_dirty = TRUE;
+  schedule_render ();
+  return TRUE;
+}
+
+/* drops oldest lines from pending log */
+static void
+trim_pending_log (guint max)
 {
-  static guint pulsate_timeout = 0;
-  float percentage = 0.0;
+  gchar *p = pending_log->str;
+  gchar *end = pending_log->str + pending_log->len;
+  guint n;
 
-  if ((condition == G_IO_IN) || (condition == G_IO_IN + G_IO_HUP))
+  for (n = pending_lines - max; n > 0 && p < end; n--)
     {
-      GString *string;
-      GError *err = NULL;
+      p = memchr (p, '\n', end - p);
+      if (p == NULL)
+        break;
+      p++;
+    }
+  if (p)
+    g_string_erase (pending_log, 0, p - pending_log->str);
+  pending_lines = max;
+}
+
+static gboolean
+flush_log_file (gpointer data)
+{
+  fflush (log_file);
+  return TRUE;
+}
 
-      string = g_string_new (NULL);
+static void
+render_progress (void)
+{
+  if (pending_fraction >= 0)
+    {
+      gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (progress_bar), pending_fraction);
+      pending_fraction = -1.0;
+    }
 
-      if (options.progress_data.pulsate)
+  if (pending_text)
+    {
+      if (options.progress_data.eta)
+        {
+          g_free (eta_label);
+          eta_label = pending_text;
+          eta_dirty = TRUE;
+        }
+      else
         {
-          if (pulsate_timeout == 0)
-            pulsate_timeout = g_timeout_add (100, pulsate_progress_bar, NULL);
+          gtk_progress_bar_set_text (GTK_PROGRESS_BAR (progress_bar), pending_text);
+          g_free (pending_text);
         }
+      pending_text = NULL;
+    }
+
+  if (eta_dirty)
+    {
+      gchar *text = format_eta ();
+
+      gtk_progress_bar_set_text (GTK_PROGRESS_BAR (progress_bar), text);
+      g_free (text);
+      eta_dirty = FALSE;
+    }
+
+  if (pending_log && pending_log->len)
+    {
+      GtkTextIter start, end;
+      gint max = options.progress_data.log_lines;
+
+      /* only last lines will be shown anyway */
+      if (max > 0 && pending_lines > max)
+        trim_pending_log (max);
 
-      while (channel->is_readable != TRUE);
+      gtk_text_buffer_get_end_iter (log_buffer, &end);
+      gtk_text_buffer_insert (log_buffer, &end, pending_log->str, pending_log->len);
+      g_string_truncate (pending_log, 0);
+      pending_lines = 0;
 
-      do
+      /* remove old lines */
+      if (max > 0)
         {
-          gint status;
+          gint count = gtk_text_buffer_get_line_count (log_buffer) - 1;
 
-          do
+          if (count > max + max / LOG_TRIM_RATIO)
             {
-              status = g_io_channel_read_line_string (channel, string, NULL, &err);
-              while (gtk_events_pending ())
-                gtk_main_iteration ();
+              gtk_text_buffer_get_start_iter (log_buffer, &start);
+              gtk_text_buffer_get_iter_at_line (log_buffer, &end, count - max);
+              gtk_text_buffer_delete (log_buffer, &start, &end);
             }
-          while (status == G_IO_STATUS_AGAIN);
+        }
 
-          if (status != G_IO_STATUS_NORMAL)
-            {
-              if (err)
-                {
-                  g_printerr ("yad_progress_handle_stdin(): %s\n", err->message);
-                  g_error_free (err);
-                  err = NULL;
-                }
-              /* stop handling */
-              g_io_channel_shutdown (channel, TRUE, NULL);
-              return FALSE;
-            }
+      /* scroll to end */
+      gtk_text_view_scroll_to_mark (GTK_TEXT_VIEW (progress_log), log_end, 0, FALSE, 0, 0);
+    }
+}
+
+static gboolean
+render_progress_cb (gpointer data)
+{
+  render_timeout = 0;
+  render_progress ();
+  return FALSE;
+}
+
+static void
+schedule_render (void)
+{
+  if (render_timeout == 0)
+    render_timeout = g_timeout_add (FRAME_INTERVAL, render_progress_cb, NULL);
+}
+
+/* flush pending state immediately */
+static void
+flush_render (void)
+{
+  if (render_timeout)
+    {
+      g_source_remove (render_timeout);
+      render_timeout = 0;
+    }
+  render_progress ();
+}
+
+/* returns TRUE if 100% has been reached */
+static gboolean
+parse_line (gchar * line)
+{
+  if (line[0] == '#')
+    {
+      gchar *match;
+
+      /* We have a comment, so let's try to change the label or write it to the log */
+      match = g_strcompress (g_strstrip (line + 1));
+      if (log_file)
+        {
+          fputs (match, log_file);
+          fputc ('\n', log_file);
+        }
+      if (options.progress_data.log)
+        {
+          gint max = options.progress_data.log_lines;
+
+          g_string_append (pending_log, match);
+          g_string_append_c (pending_log, '\n');
+          g_free (match);
+
+          /* keep the memory bounded between redraws */
+          pending_lines++;
+          if (max > 0 && pending_lines > 2 * max)
+            trim_pending_log (max);
+        }
+      else
+        {
+          g_free (pending_text);
+          pending_text = match;
+        }
+    }
+  else if (g_ascii_isdigit (*line) || *line == '.')
+    {
+      gchar *end;
+      gdouble done, total = 100.0;
+
+      /* Now try to convert the thing to a number. Both percentage and DONE/TOTAL are accepted */
+      done = g_ascii_strtod (line, &end);
+      if (*end == '/')
+        {
+          total = g_ascii_strtod (end + 1, NULL);
+          if (total <= 0)
+            return FALSE;
+        }
+
+      if (eta_timer)
+        update_rate (done, total);
+
+      if (done >= total)
+        {
+          pending_fraction = 1.0;
+          return TRUE;
+        }
+      pending_fraction = done / total;
+    }
+
+  return FALSE;
+}
+
+static void
+finish_progress (void)
+{
+  pending_fraction = 1.0;
+  flush_render ();
+
+  if (pulsate_timeout)
+    {
+      g_source_remove (pulsate_timeout);
+      pulsate_timeout = 0;
+    }
+
+  if (options.progress_data.autoclose && options.plug == -1)
+    yad_exit (options.data.def_resp);
+}
+
+static gboolean
+write_all (gint fd, const gchar * buf, gssize len)
+{
+  while (len > 0)
+    {
+      gssize n = write (fd, buf, len);
+
+      if (n < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return FALSE;
+        }
+      buf += n;
+      len -= n;
+    }
+  return TRUE;
+}
+
+/* copies stdin to stdout and counts bytes. UI only samples the counter */
+static gpointer
+pipe_thread (gpointer data)
+{
+  gchar *buf = NULL;
+  guint64 done = 0;
+  gint fd;
+#ifdef HAVE_SPLICE
+  gboolean use_splice = TRUE;
+#endif
+
+  while (TRUE)
+    {
+      gssize n;
 
-          if (string->str[0] == '#')
+#ifdef HAVE_SPLICE
+      if (use_splice)
+        {
+          /* move data between descriptors inside the kernel */
+          n = splice (0, NULL, 1, NULL, PIPE_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE);
+          if (n < 0 && (errno == EINVAL || errno == ENOSYS))
             {
-              gchar *match;
-
-              /* We have a comment, so let's try to change the label or write it to the log */
-              match = g_strcompress (g_strstrip (string->str + 1));
-              if (options.progress_data.log)
-                {
-                  gchar *logline;
-                  GtkTextIter end;
-
-                  logline = g_strdup_printf ("%s\n", match);    /* add new line */
-                  gtk_text_buffer_get_end_iter (log_buffer, &end);
-                  gtk_text_buffer_insert (log_buffer, &end, logline, -1);
-                  g_free (logline);
-
-                  /* scroll to end */
-                  while (gtk_events_pending ())
-                    gtk_main_iteration ();
-                  gtk_text_buffer_get_end_iter (log_buffer, &end);
-                  gtk_text_view_scroll_to_iter (GTK_TEXT_VIEW (progress_log), &end, 0, FALSE, 0, 0);
-                }
-              else
-                gtk_progress_bar_set_text (GTK_PROGRESS_BAR (progress_bar), match);
-              g_free (match);
+              /* neither of descriptors is a pipe */
+              use_splice = FALSE;
+              continue;
             }
-          else
+        }
+      else
+#endif
+        {
+          if (buf == NULL)
+            buf = g_malloc (PIPE_CHUNK);
+          n = read (0, buf, PIPE_CHUNK);
+          if (n > 0 && !write_all (1, buf, n))
+            n = -1;
+        }
+
+      if (n == 0)
+        break;
+      if (n < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          g_printerr ("yad_progress_pipe(): %s\n", g_strerror (errno));
+          break;
+        }
+
+      done += n;
+      write_shm_counter (&pipe_counter, done, options.progress_data.size);
+    }
+  g_free (buf);
+
+  /* let the reader see the end of data, even if dialog is still open */
+  fd = open ("/dev/null", O_WRONLY);
+  if (fd >= 0)
+    {
+      dup2 (fd, 1);
+      close (fd);
+    }
+  g_atomic_int_set (&pipe_finished, 1);
+
+  return NULL;
+}
+
+/* applies new counter values. Returns FALSE if progress is finished */
+static gboolean
+update_counter (guint64 done, guint64 total, gboolean pulse)
+{
+  if (total == 0)
+    {
+      if (pulse && done != shm_done)
+        {
+          /* size is unknown, just show the activity */
+          gtk_progress_bar_pulse (GTK_PROGRESS_BAR (progress_bar));
+          if (eta_timer)
             {
-              if (g_ascii_isdigit (*(string->str)))
-                {
-                  /* Now try to convert the thing to a number */
-                  percentage = atoi (string->str);
-                  if (percentage >= 100)
-                    {
-                      gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (progress_bar), 1.0);
-                      if (options.progress_data.autoclose && options.plug == -1)
-                        yad_exit (options.data.def_resp);
-                    }
-                  else
-                    gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (progress_bar), percentage / 100.0);
-                }
+              update_rate (done, 0);
+              flush_render ();
             }
+        }
+      shm_done = done;
+      return TRUE;
+    }
+
+  if (done == shm_done && total == shm_total)
+    return TRUE;
 
+  shm_done = done;
+  shm_total = total;
+
+  if (eta_timer)
+    update_rate (done, total);
+
+  if (done >= total)
+    {
+      pending_fraction = 1.0;
+      flush_render ();
+      if (options.progress_data.autoclose && options.plug == -1)
+        {
+          yad_exit (options.data.def_resp);
+          return FALSE;
         }
-      while (g_io_channel_get_buffer_condition (channel) == G_IO_IN);
-      g_string_free (string, TRUE);
+    }
+  else
+    {
+      pending_fraction = (gdouble) done / total;
+      flush_render ();
     }
 
-  if ((condition != G_IO_IN) && (condition != G_IO_IN + G_IO_HUP))
+  return TRUE;
+}
+
+/* reads progress counter once per frame */
+static gboolean
+sample_shm (gpointer data)
+{
+  guint64 done, total;
+
+  read_shm_counter (shm_counter, &done, &total);
+
+  if (shm_counter == &pipe_counter)
     {
-      gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (progress_bar), 1.0);
+      if (g_atomic_int_get (&pipe_finished))
+        {
+          if (eta_timer)
+            update_rate (done, total ? total : done);
+          finish_progress ();
+          return FALSE;
+        }
+      return update_counter (done, total, TRUE);
+    }
+
+  return update_counter (done, total, FALSE);
+}
+
+/* reads i/o counter of watched process. Returns FALSE if process doesn't exist */
+static gboolean
+read_proc_io (guint64 * val)
+{
+  static gboolean no_access = FALSE;
+  gchar *fn, *buf, *p;
+  const gchar *key;
+  gboolean res = TRUE;
+
+  *val = 0;
 
-      if (options.progress_data.pulsate)
+  if (no_access)
+    return (kill (options.progress_data.watch_pid, 0) == 0 || errno == EPERM);
+
+  fn = g_strdup_printf ("/proc/%d/io", options.progress_data.watch_pid);
+  if (!g_file_get_contents (fn, &buf, NULL, NULL))
+    {
+      g_free (fn);
+      /* file exists but unreadable, watch only for process existence */
+      if (kill (options.progress_data.watch_pid, 0) == 0 || errno == EPERM)
         {
-          g_source_remove (pulsate_timeout);
-          pulsate_timeout = 0;
+          g_printerr (_("Cannot read i/o counters of process %d\n"), options.progress_data.watch_pid);
+          no_access = TRUE;
+          return TRUE;
         }
+      return FALSE;
+    }
+  g_free (fn);
 
-      if (options.progress_data.autoclose && options.plug == -1)
-        yad_exit (options.data.def_resp);
+  key = options.progress_data.watch_write ? "wchar:" : "rchar:";
+  if ((p = strstr (buf, key)) != NULL)
+    *val = g_ascii_strtoull (p + strlen (key), NULL, 10);
+  else
+    res = FALSE;
+  g_free (buf);
+
+  return res;
+}
 
+/* samples watched file or process */
+static gboolean
+sample_watch (gpointer data)
+{
+  guint64 done = 0;
+
+  if (options.progress_data.watch_pid > 0 && !read_proc_io (&done))
+    {
+      /* process has been finished */
+      if (options.progress_data.watch_file && eta_timer)
+        update_rate (shm_done, shm_done);
+      finish_progress ();
+      return FALSE;
+    }
+
+  if (options.progress_data.watch_file)
+    {
+      struct stat st;
+
+      /* file may not be created yet */
+      if (stat (options.progress_data.watch_file, &st) != 0)
+        return TRUE;
+      done = st.st_size;
+    }
+
+  return update_counter (done, options.progress_data.size, TRUE);
+}
+
+/* stops processing of input when dialog must be closed */
+static gboolean
+input_line_cb (gchar * line, gpointer data)
+{
+  return !(parse_line (line) && options.progress_data.autoclose && options.plug == -1);
+}
+
+/* called after each portion of input from stdin or socket */
+static void
+input_batch_cb (gboolean stopped, gpointer data)
+{
+  if (options.progress_data.pulsate && pulsate_timeout == 0)
+    pulsate_timeout = g_timeout_add (100, pulsate_progress_bar, NULL);
+
+  if (stopped)
+    {
+      /* final 100 must be shown before closing */
+      flush_render ();
+      yad_exit (options.data.def_resp);
+    }
+  else
+    schedule_render ();
+}
+
+static gboolean
+handle_stdin (GIOChannel * channel, GIOCondition condition, gpointer data)
+{
+  gchar buf[READ_BLOCK_SIZE];
+  gboolean eof = FALSE;
+  gint n;
+
+  /* drain all available input */
+  for (n = 0; n < MAX_READ_BLOCKS; n++)
+    {
+      GIOStatus status;
+      GError *err = NULL;
+      gsize len = 0;
+
+      status = g_io_channel_read_chars (channel, buf, READ_BLOCK_SIZE, &len, &err);
+      if (len > 0)
+        g_string_append_len (in_buf, buf, len);
+
+      if (status == G_IO_STATUS_AGAIN)
+        break;
+      if (status != G_IO_STATUS_NORMAL)
+        {
+          if (err)
+            {
+              g_printerr ("yad_progress_handle_stdin(): %s\n", err->message);
+              g_error_free (err);
+            }
+          eof = TRUE;
+          break;
+        }
+    }
+
+  if (!process_lines (in_buf, eof, input_line_cb, NULL))
+    {
+      input_batch_cb (TRUE, NULL);
+      return TRUE;
+    }
+
+  if ((eof || ((condition & G_IO_HUP) && !(condition & G_IO_IN))) && (shm_counter || watch_source))
+    {
+      /* progress is finished by counter, not by the end of stdin */
+      input_batch_cb (FALSE, NULL);
+      g_io_channel_shutdown (channel, TRUE, NULL);
+      return FALSE;
+    }
+  else if (eof || ((condition & G_IO_HUP) && !(condition & G_IO_IN)))
+    {
+      finish_progress ();
       g_io_channel_shutdown (channel, TRUE, NULL);
       return FALSE;
     }
+
+  input_batch_cb (FALSE, NULL);
   return TRUE;
 }
 
@@ -185,6 +744,7 @@ progress_create_widget (GtkWidget * dlg)
   if (options.progress_data.log)
     {
       GtkWidget *ex, *sw;
+      GtkTextIter iter;
 
       ex = gtk_expander_new (options.progress_data.log);
       gtk_expander_set_spacing (GTK_EXPANDER (ex), 2);
@@ -207,16 +767,79 @@ progress_create_widget (GtkWidget * dlg)
       gtk_text_view_set_right_margin (GTK_TEXT_VIEW (progress_log), 5);
       gtk_text_view_set_editable (GTK_TEXT_VIEW (progress_log), FALSE);
       gtk_text_view_set_cursor_visible (GTK_TEXT_VIEW (progress_log), FALSE);
+
+      gtk_text_buffer_get_end_iter (log_buffer, &iter);
+      log_end = gtk_text_buffer_create_mark (log_buffer, NULL, &iter, FALSE);
+      pending_log = g_string_new (NULL);
     }
 #if GTK_CHECK_VERSION(3,0,0)
-  else
+  if (!options.progress_data.log || options.progress_data.eta)
     gtk_progress_bar_set_show_text (GTK_PROGRESS_BAR (progress_bar), TRUE);
 #endif
 
-  channel = g_io_channel_unix_new (0);
-  g_io_channel_set_encoding (channel, NULL, NULL);
-  g_io_channel_set_flags (channel, G_IO_FLAG_NONBLOCK, NULL);
-  g_io_add_watch (channel, G_IO_IN | G_IO_HUP, handle_stdin, dlg);
+  if (options.progress_data.eta)
+    {
+      eta_timer = g_timer_new ();
+      cur_done = sample_done = options.progress_data.percentage;
+      eta_label = g_strdup (options.progress_data.progress_text);
+      eta_dirty = TRUE;
+      render_progress ();
+      g_timeout_add_seconds (1, eta_tick, NULL);
+    }
+
+  if (options.progress_data.log_file)
+    {
+      log_file = fopen (options.progress_data.log_file, "w");
+      if (log_file)
+        {
+          setvbuf (log_file, NULL, _IOFBF, LOG_FILE_BUFFER);
+          g_timeout_add_seconds (1, flush_log_file, NULL);
+        }
+      else
+        g_printerr (_("Cannot open log file %s: %s\n"), options.progress_data.log_file, g_strerror (errno));
+    }
+
+  if (options.progress_data.pipe)
+    {
+      /* stdin is copied to stdout by separate thread */
+      if (options.progress_data.size < 0)
+        options.progress_data.size = 0;
+      shm_counter = &pipe_counter;
+#if GLIB_CHECK_VERSION(2,32,0)
+      g_thread_unref (g_thread_new ("pipe", pipe_thread, NULL));
+#else
+      g_thread_create (pipe_thread, NULL, FALSE, NULL);
+#endif
+      g_timeout_add (FRAME_INTERVAL, sample_shm, NULL);
+    }
+  else if (options.progress_data.shm)
+    {
+      shm_counter = open_shm_counters (options.progress_data.shm, 1);
+      if (shm_counter)
+        g_timeout_add (FRAME_INTERVAL, sample_shm, NULL);
+    }
+  else if (options.progress_data.watch_file || options.progress_data.watch_pid)
+    {
+      if (options.progress_data.size < 0)
+        options.progress_data.size = 0;
+      watch_source = g_timeout_add (WATCH_INTERVAL, sample_watch, NULL);
+    }
+
+  if (options.common_data.socket)
+    {
+      /* data from all of clients are merged together */
+      if (!listen_socket (options.common_data.socket, input_line_cb, input_batch_cb, NULL))
+        exit (-1);
+    }
+  else if (!options.progress_data.pipe)
+    {
+      in_buf = g_string_new (NULL);
+
+      channel = g_io_channel_unix_new (0);
+      g_io_channel_set_encoding (channel, NULL, NULL);
+      g_io_channel_set_flags (channel, G_IO_FLAG_NONBLOCK, NULL);
+      g_io_add_watch (channel, G_IO_IN | G_IO_HUP, handle_stdin, dlg);
+    }
 
   return w;
 }
@@ -17,6 +17,9 @@
  * Copyright (C) 2008-2017, Victor Ananjevsky <ananasik@gmail.com>
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+
 #include "yad.h"
 
 enum {
@@ -24,15 +27,88 @@ enum {
   MINUS_BTN,
 };
 
+#define READ_BLOCK_SIZE 4096
+#define MAX_READ_BLOCKS 64
+
 static GtkWidget *scale;
 static GtkWidget *plus_btn = NULL;
 static GtkWidget *minus_btn = NULL;
 
+/* partial output */
+static gchar *last_printed = NULL;
+static gboolean partial_pending = FALSE;
+static guint partial_timeout = 0;
+
+/* values from stdin or socket */
+static GString *in_buf = NULL;
+static gdouble new_value;
+static gboolean have_new_value = FALSE;
+static gboolean external_change = FALSE;
+
+static void
+print_partial ()
+{
+  gchar *str = g_strdup_printf ("%.0f", gtk_range_get_value (GTK_RANGE (scale)));
+
+  if (g_strcmp0 (str, last_printed) != 0)
+    {
+      g_print ("%s\n", str);
+      /* consumer reads values immediately */
+      fflush (stdout);
+      g_free (last_printed);
+      last_printed = str;
+    }
+  else
+    g_free (str);
+}
+
+static gboolean
+partial_timeout_cb (gpointer data)
+{
+  if (partial_pending)
+    {
+      /* print the last value and wait for the next interval */
+      partial_pending = FALSE;
+      print_partial ();
+      return TRUE;
+    }
+
+  partial_timeout = 0;
+  return FALSE;
+}
+
+/* print value delayed by --partial-interval. Called when main loop is finished,
+ * so the last value is not lost on any kind of dialog closing */
+void
+scale_flush_partial (void)
+{
+  if (partial_timeout)
+    {
+      g_source_remove (partial_timeout);
+      partial_timeout = 0;
+    }
+  if (partial_pending)
+    {
+      partial_pending = FALSE;
+      print_partial ();
+    }
+}
+
 static void
 value_changed_cb (GtkWidget * w, gpointer data)
 {
-  if (options.scale_data.print_partial)
-    g_print ("%.0f\n", gtk_range_get_value (GTK_RANGE (scale)));
+  if (options.scale_data.print_partial && !external_change)
+    {
+      if (options.scale_data.partial_interval <= 0)
+        print_partial ();
+      else if (partial_timeout == 0)
+        {
+          print_partial ();
+          partial_timeout = g_timeout_add (options.scale_data.partial_interval, partial_timeout_cb, NULL);
+        }
+      else
+        partial_pending = TRUE;
+    }
 
   if (options.scale_data.buttons)
     {
@@ -68,6 +144,91 @@ vb_pressed (GtkWidget *b, gpointer data)
     }
 }
 
+static gboolean
+input_line_cb (gchar * line, gpointer data)
+{
+  gchar *end;
+  gdouble v;
+
+  g_strstrip (line);
+  if (!line[0])
+    return TRUE;
+
+  v = g_ascii_strtod (line, &end);
+  if (*end)
+    {
+      g_printerr (_("Invalid value '%s'\n"), line);
+      return TRUE;
+    }
+
+  /* only the last value of a portion is applied */
+  new_value = CLAMP (v, options.scale_data.min_value, options.scale_data.max_value);
+  have_new_value = TRUE;
+
+  return TRUE;
+}
+
+static void
+input_batch_cb (gboolean stopped, gpointer data)
+{
+  if (!have_new_value)
+    return;
+  have_new_value = FALSE;
+
+  /* don't send value back to its source */
+  external_change = TRUE;
+  gtk_range_set_value (GTK_RANGE (scale), new_value);
+  external_change = FALSE;
+
+  g_free (last_printed);
+  last_printed = g_strdup_printf ("%.0f", gtk_range_get_value (GTK_RANGE (scale)));
+}
+
+static gboolean
+handle_stdin (GIOChannel * channel, GIOCondition condition, gpointer data)
+{
+  gchar buf[READ_BLOCK_SIZE];
+  gboolean eof = FALSE;
+  gint n;
+
+  for (n = 0; n < MAX_READ_BLOCKS; n++)
+    {
+      GIOStatus status;
+      GError *err = NULL;
+      gsize len = 0;
+
+      status = g_io_channel_read_chars (channel, buf, READ_BLOCK_SIZE, &len, &err);
+      if (len > 0)
+        g_string_append_len (in_buf, buf, len);
+
+      if (status == G_IO_STATUS_AGAIN)
+        break;
+      if (status != G_IO_STATUS_NORMAL)
+        {
+          if (err)
+            {
+              g_printerr ("yad_scale_handle_stdin(): %s\n", err->message);
+              g_error_free (err);
+            }
+          eof = TRUE;
+          break;
+        }
+    }
+  if ((condition & G_IO_HUP) && !(condition & G_IO_IN))
+    eof = TRUE;
+
+  process_lines (in_buf, eof, input_line_cb, NULL);
+  input_batch_cb (FALSE, NULL);
+
+  if (eof)
+    {
+      g_io_channel_shutdown (channel, TRUE, NULL);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
 GtkWidget *
 scale_create_widget (GtkWidget * dlg)
 {
@@ -188,6 +349,23 @@ scale_create_widget (GtkWidget * dlg)
   g_signal_connect (G_OBJECT (scale), "value-changed", G_CALLBACK (value_changed_cb), NULL);
   gtk_widget_grab_focus (scale);
 
+  /* set value from outside */
+  if (options.common_data.listen)
+    {
+      GIOChannel *channel;
+
+      in_buf = g_string_sized_new (READ_BLOCK_SIZE);
+      channel = g_io_channel_unix_new (0);
+      if (channel)
+        {
+          g_io_channel_set_encoding (channel, NULL, NULL);
+          g_io_channel_set_flags (channel, G_IO_FLAG_NONBLOCK, NULL);
+          g_io_add_watch (channel, G_IO_IN | G_IO_HUP, handle_stdin, NULL);
+        }
+    }
+  if (options.common_data.socket && !listen_socket (options.common_data.socket, input_line_cb, input_batch_cb, NULL))
+    exit (-1);
+
   return w;
 }
 
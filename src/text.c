@@ -18,6 +18,10 @@
  */
 
 #include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <pango/pango.h>
 
@@ -31,58 +35,242 @@ static gchar *pattern = NULL;
 static gboolean new_search = TRUE;
 
 /* searching */
+#define SEARCH_BATCH_SIZE 1024
+
+typedef struct {
+  gint start;
+  gint end;
+} SearchMatch;
+
+typedef struct {
+  gint gen;
+  gchar *pattern;
+  gchar *text;
+} SearchJob;
+
+typedef struct {
+  gint gen;
+  GArray *matches;
+  gchar *error;
+  gboolean done;
+} SearchBatch;
+
+static GThreadPool *search_pool = NULL;
+static volatile gint search_gen = 0;
+static GArray *matches = NULL;
+static gint cur_match = -1;
+static gint search_from = 0;
+static gboolean search_done = TRUE;
+static GtkTextTag *search_tag = NULL;
+static GtkWidget *search_label = NULL;
+
 static void
-do_search (GtkWidget * e, GtkWidget * w)
+update_search_label (const gchar * msg)
 {
-  static gchar *text = NULL;
-  static guint offset;
-  static GRegex *regex = NULL;
-  GMatchInfo *match = NULL;
+  gchar *str;
+
+  if (search_label == NULL)
+    return;
+
+  if (msg)
+    str = g_strdup (msg);
+  else if (matches->len == 0)
+    str = g_strdup (search_done ? _("No matches") : "...");
+  else
+    str = g_strdup_printf (search_done ? "%d/%d" : "%d/%d+", cur_match + 1, matches->len);
+
+  gtk_label_set_text (GTK_LABEL (search_label), str);
+  g_free (str);
+}
+
+static void
+select_match (gint n)
+{
+  SearchMatch *sm;
   GtkTextIter begin, end;
+  gint len = matches ? matches->len : 0;
+
+  if (len == 0)
+    return;
+
+  cur_match = (n % len + len) % len;
+  sm = &g_array_index (matches, SearchMatch, cur_match);
+
+  gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (text_buffer), &begin, sm->start);
+  gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (text_buffer), &end, sm->end);
+
+  gtk_text_buffer_select_range (GTK_TEXT_BUFFER (text_buffer), &begin, &end);
+  gtk_text_view_scroll_to_iter (GTK_TEXT_VIEW (text_view), &begin, 0, FALSE, 0, 0);
+
+  update_search_label (NULL);
+}
+
+static gboolean
+search_batch_cb (SearchBatch * b)
+{
+  /* drop results of superseded searches */
+  if (b->gen == g_atomic_int_get (&search_gen))
+    {
+      guint i;
+      gint first = -1;
+
+      for (i = 0; i < b->matches->len; i++)
+        {
+          SearchMatch *sm = &g_array_index (b->matches, SearchMatch, i);
+          GtkTextIter begin, end;
+
+          gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (text_buffer), &begin, sm->start);
+          gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (text_buffer), &end, sm->end);
+          gtk_text_buffer_apply_tag (GTK_TEXT_BUFFER (text_buffer), search_tag, &begin, &end);
+
+          if (cur_match < 0 && first < 0 && sm->start >= search_from)
+            first = matches->len + i;
+        }
+      g_array_append_vals (matches, b->matches->data, b->matches->len);
+      search_done = b->done;
+
+      if (b->error)
+        update_search_label (b->error);
+      else if (first >= 0)
+        select_match (first);
+      else if (cur_match < 0 && search_done && matches->len > 0)
+        select_match (0);
+      else
+        update_search_label (NULL);
+    }
+
+  g_array_free (b->matches, TRUE);
+  g_free (b->error);
+  g_free (b);
+
+  return FALSE;
+}
+
+static void
+search_post (SearchJob * job, GArray * m, gchar * error, gboolean done)
+{
+  SearchBatch *b = g_new0 (SearchBatch, 1);
 
-  g_free (pattern);
-  pattern = g_strdup (gtk_entry_get_text (GTK_ENTRY (e)));
-  gtk_widget_destroy (w);
-  gtk_widget_queue_draw (text_view);
+  b->gen = job->gen;
+  b->matches = m;
+  b->error = error;
+  b->done = done;
 
-  if (new_search || gtk_text_buffer_get_modified (GTK_TEXT_BUFFER (text_buffer)))
+  g_idle_add ((GSourceFunc) search_batch_cb, b);
+}
+
+static void
+search_thread (SearchJob * job, gpointer data)
+{
+  GRegex *regex;
+  GMatchInfo *match = NULL;
+  GArray *m;
+  GError *err = NULL;
+  const gchar *pos;
+  gint ofs = 0;
+
+  if (job->gen != g_atomic_int_get (&search_gen))
+    goto out;
+
+  /* G_REGEX_OPTIMIZE turns on the JIT compiler if pcre supports it */
+  regex = g_regex_new (job->pattern, G_REGEX_EXTENDED | G_REGEX_OPTIMIZE, G_REGEX_MATCH_NOTEMPTY, &err);
+  if (regex == NULL)
     {
-      /* get the text */
-      g_free (text);
-      gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (text_buffer), &begin, &end);
-      text = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (text_buffer), &begin, &end, FALSE);
-      offset = 0;
-      /* compile new regex */
-      if (regex)
-        g_regex_unref (regex);
-      regex = g_regex_new (pattern, G_REGEX_EXTENDED | G_REGEX_OPTIMIZE, G_REGEX_MATCH_NOTEMPTY, NULL);
-      new_search = FALSE;
+      search_post (job, g_array_new (FALSE, FALSE, sizeof (SearchMatch)), g_strdup (err->message), TRUE);
+      g_error_free (err);
+      goto out;
     }
 
-  /* search and select if found */
-  if (g_regex_match (regex, text + offset, G_REGEX_MATCH_NOTEMPTY, &match))
+  m = g_array_sized_new (FALSE, FALSE, sizeof (SearchMatch), SEARCH_BATCH_SIZE);
+  pos = job->text;
+
+  g_regex_match (regex, job->text, G_REGEX_MATCH_NOTEMPTY, &match);
+  while (g_match_info_matches (match))
     {
-      gint sp, ep, spos, epos;
+      SearchMatch sm;
+      gint sp, ep;
+
+      if (job->gen != g_atomic_int_get (&search_gen))
+        break;
 
       g_match_info_fetch_pos (match, 0, &sp, &ep);
 
-      /* positions are in bytes, not character, so here we must normalize it */
-      spos = g_utf8_pointer_to_offset (text, text + sp + offset);
-      epos = g_utf8_pointer_to_offset (text, text + ep + offset);
+      /* positions are in bytes, not characters. count characters only
+       * from the end of previous match, so whole text is walked once */
+      sm.start = ofs + g_utf8_strlen (pos, job->text + sp - pos);
+      sm.end = sm.start + g_utf8_strlen (job->text + sp, ep - sp);
+      g_array_append_val (m, sm);
 
-      gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (text_buffer), &begin, spos);
-      gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (text_buffer), &end, epos);
+      ofs = sm.end;
+      pos = job->text + ep;
 
-      gtk_text_buffer_select_range (GTK_TEXT_BUFFER (text_buffer), &begin, &end);
-      gtk_text_view_scroll_to_iter (GTK_TEXT_VIEW (text_view), &begin, 0, FALSE, 0, 0);
+      if (m->len == SEARCH_BATCH_SIZE)
+        {
+          search_post (job, m, NULL, FALSE);
+          m = g_array_sized_new (FALSE, FALSE, sizeof (SearchMatch), SEARCH_BATCH_SIZE);
+        }
 
-      offset += epos;
+      g_match_info_next (match, NULL);
+    }
+  g_match_info_free (match);
+  g_regex_unref (regex);
+
+  search_post (job, m, NULL, TRUE);
+
+out:
+  g_free (job->pattern);
+  g_free (job->text);
+  g_free (job);
+}
+
+static void
+start_search (void)
+{
+  SearchJob *job;
+  GtkTextIter begin, end;
+
+  /* new generation supersedes all running searches */
+  g_atomic_int_inc (&search_gen);
+
+  job = g_new0 (SearchJob, 1);
+  job->gen = g_atomic_int_get (&search_gen);
+  job->pattern = g_strdup (pattern);
+
+  gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (text_buffer), &begin, &end);
+  job->text = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (text_buffer), &begin, &end, FALSE);
+  gtk_text_buffer_remove_tag (GTK_TEXT_BUFFER (text_buffer), search_tag, &begin, &end);
+
+  /* continue from the end of current selection */
+  gtk_text_buffer_get_selection_bounds (GTK_TEXT_BUFFER (text_buffer), &begin, &end);
+  search_from = gtk_text_iter_get_offset (&end);
+
+  g_array_set_size (matches, 0);
+  cur_match = -1;
+  search_done = FALSE;
+  new_search = FALSE;
+  update_search_label (NULL);
 
-      g_match_info_free (match);
-      match = NULL;
+  if (search_pool == NULL)
+    search_pool = g_thread_pool_new ((GFunc) search_thread, NULL, 1, FALSE, NULL);
+  g_thread_pool_push (search_pool, job, NULL);
+}
+
+static void
+do_search (GtkWidget * e, gpointer data)
+{
+  const gchar *str = gtk_entry_get_text (GTK_ENTRY (e));
+
+  if (str[0] == '\0')
+    return;
+
+  if (new_search || g_strcmp0 (pattern, str) != 0)
+    {
+      g_free (pattern);
+      pattern = g_strdup (str);
+      start_search ();
     }
   else
-    new_search = TRUE;
+    select_match (cur_match + 1);
 }
 
 static gboolean
@@ -97,19 +285,63 @@ search_key_cb (GtkWidget * w, GdkEventKey * key, GtkWidget * win)
       gtk_widget_destroy (win);
       return TRUE;
     }
+#if GTK_CHECK_VERSION(2,24,0)
+  else if ((key->state & GDK_SHIFT_MASK) && (key->keyval == GDK_KEY_Return || key->keyval == GDK_KEY_KP_Enter))
+#else
+  else if ((key->state & GDK_SHIFT_MASK) && (key->keyval == GDK_Return || key->keyval == GDK_KP_Enter))
+#endif
+    {
+      if (!new_search)
+        select_match (cur_match - 1);
+      return TRUE;
+    }
   return FALSE;
 }
 
+/* cancel running search and drop its results */
 static void
-search_changed (GtkWidget * w, gpointer d)
+reset_search (void)
 {
+  GtkTextIter begin, end;
+
+  g_atomic_int_inc (&search_gen);
   new_search = TRUE;
+
+  if (matches->len == 0 && search_done)
+    return;
+
+  gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (text_buffer), &begin, &end);
+  gtk_text_buffer_remove_tag (GTK_TEXT_BUFFER (text_buffer), search_tag, &begin, &end);
+
+  g_array_set_size (matches, 0);
+  cur_match = -1;
+  search_done = TRUE;
+  update_search_label ("");
+}
+
+static void
+search_changed (GtkWidget * w, gpointer d)
+{
+  reset_search ();
+}
+
+static void
+search_destroy_cb (GtkWidget * w, gpointer d)
+{
+  search_label = NULL;
+}
+
+static void
+buffer_changed_cb (GtkTextBuffer * buf, gpointer d)
+{
+  /* offsets of found matches are not valid anymore */
+  reset_search ();
 }
 
 static void
 show_search ()
 {
-  GtkWidget *w, *f, *a, *e;
+  GtkWidget *w, *f, *a, *b, *e;
   GdkEvent *fev;
 
   w = gtk_window_new (GTK_WINDOW_POPUP);
@@ -120,6 +352,7 @@ show_search ()
   gtk_window_set_modal (GTK_WINDOW (w), TRUE);
 
   g_signal_connect (G_OBJECT (w), "key-press-event", G_CALLBACK (search_key_cb), w);
+  g_signal_connect (G_OBJECT (w), "destroy", G_CALLBACK (search_destroy_cb), NULL);
 
   f = gtk_frame_new (NULL);
   gtk_frame_set_shadow_type (GTK_FRAME (f), GTK_SHADOW_ETCHED_IN);
@@ -129,12 +362,24 @@ show_search ()
   gtk_alignment_set_padding (GTK_ALIGNMENT (a), 2, 2, 2, 2);
   gtk_container_add (GTK_CONTAINER (f), a);
 
+#if !GTK_CHECK_VERSION(3,0,0)
+  b = gtk_hbox_new (FALSE, 5);
+#else
+  b = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 5);
+#endif
+  gtk_container_add (GTK_CONTAINER (a), b);
+
   e = gtk_entry_new ();
   if (pattern)
     gtk_entry_set_text (GTK_ENTRY (e), pattern);
-  gtk_container_add (GTK_CONTAINER (a), e);
+  gtk_box_pack_start (GTK_BOX (b), e, TRUE, TRUE, 0);
+
+  search_label = gtk_label_new (NULL);
+  gtk_box_pack_start (GTK_BOX (b), search_label, FALSE, FALSE, 2);
+  if (pattern && !new_search)
+    update_search_label (NULL);
 
-  g_signal_connect (G_OBJECT (e), "activate", G_CALLBACK (do_search), w);
+  g_signal_connect (G_OBJECT (e), "activate", G_CALLBACK (do_search), NULL);
   g_signal_connect (G_OBJECT (e), "changed", G_CALLBACK (search_changed), NULL);
   g_signal_connect (G_OBJECT (e), "key-press-event", G_CALLBACK (search_key_cb), w);
 
@@ -260,7 +505,7 @@ linkify_cb (GtkTextBuffer * buf, GRegex * regex)
   gtk_text_buffer_get_bounds (buf, &start, &end);
   text = gtk_text_buffer_get_text (buf, &start, &end, FALSE);
 
-  gtk_text_buffer_remove_all_tags (buf, &start, &end);
+  gtk_text_buffer_remove_tag (buf, tag, &start, &end);
 
   if (g_regex_match (regex, text, G_REGEX_MATCH_NOTEMPTY, &match))
     {
@@ -286,76 +531,699 @@ linkify_cb (GtkTextBuffer * buf, GRegex * regex)
   g_free (text);
 }
 
-static gboolean
-handle_stdin (GIOChannel * channel, GIOCondition condition, gpointer data)
+/* input data handling */
+#define READ_BLOCK_SIZE 65536
+#define MAX_READ_BLOCKS 16
+
+static GIConv conv = (GIConv) -1;
+static GString *in_buf = NULL;
+static GString *out_buf = NULL;
+static GString *carry = NULL;
+static gboolean at_line_start = TRUE;
+static gboolean skip_line = FALSE;
+
+static inline void
+append_invalid (GString * out, guchar ch)
 {
-  if ((condition & G_IO_IN) || (condition & (G_IO_IN | G_IO_HUP)))
+  /* invalid byte is taken as ISO-8859-1 character if no replacement requested */
+  if (options.text_data.replace_invalid || ch == '\0')
+    g_string_append_len (out, "\357\277\275", 3);
+  else
+    g_string_append_unichar (out, ch);
+}
+
+/* converts block of input data to utf-8. incomplete character at the end
+ * of block is kept until next call. returned string is valid until next call */
+static const gchar *
+decode_data (const gchar * data, gsize len, gsize * out_len)
+{
+  if (carry->len > 0)
     {
-      GString *string;
-      GError *err = NULL;
-      gint status;
+      g_string_truncate (in_buf, 0);
+      g_string_append_len (in_buf, carry->str, carry->len);
+      g_string_append_len (in_buf, data, len);
+      g_string_truncate (carry, 0);
+      data = in_buf->str;
+      len = in_buf->len;
+    }
 
-      string = g_string_new (NULL);
-      while (channel->is_readable != TRUE);
+  g_string_truncate (out_buf, 0);
 
-      do
+  if (conv != (GIConv) -1)
+    {
+      gchar *inbuf = (gchar *) data;
+      gsize inleft = len;
+
+      while (inleft > 0)
         {
-          status = g_io_channel_read_line_string (channel, string, NULL, &err);
-          while (gtk_events_pending ())
-            gtk_main_iteration ();
+          gchar obuf[4096], *outbuf = obuf;
+          gsize outleft = sizeof (obuf);
+
+          if (g_iconv (conv, &inbuf, &inleft, &outbuf, &outleft) == (gsize) -1)
+            {
+              gint e = errno;
+
+              g_string_append_len (out_buf, obuf, outbuf - obuf);
+              if (e == EINVAL)
+                {
+                  g_string_append_len (carry, inbuf, inleft);
+                  break;
+                }
+              else if (e == EILSEQ)
+                {
+                  append_invalid (out_buf, *inbuf);
+                  inbuf++;
+                  inleft--;
+                }
+            }
+          else
+            g_string_append_len (out_buf, obuf, outbuf - obuf);
         }
-      while (status == G_IO_STATUS_AGAIN);
+    }
+  else
+    {
+      const gchar *p = data, *e = data + len, *end;
 
-      if (status != G_IO_STATUS_NORMAL)
+      /* most common case - whole block is valid */
+      if (validate_utf8 (p, len, &end))
         {
-          if (err)
+          *out_len = len;
+          return data;
+        }
+
+      while (TRUE)
+        {
+          g_string_append_len (out_buf, p, end - p);
+          p = end;
+          if (p == e)
+            break;
+
+          if (e - p < 4 && g_utf8_get_char_validated (p, e - p) == (gunichar) -2)
             {
-              g_printerr ("yad_text_handle_stdin(): %s\n", err->message);
-              g_error_free (err);
-              err = NULL;
+              g_string_append_len (carry, p, e - p);
+              break;
             }
-          /* stop handling */
-          g_io_channel_shutdown (channel, TRUE, NULL);
-          return FALSE;
+          append_invalid (out_buf, *p);
+          p++;
+
+          validate_utf8 (p, e - p, &end);
         }
+    }
+
+  *out_len = out_buf->len;
+  return out_buf->str;
+}
+
+/* flush the rest of input data at the end of stream */
+static const gchar *
+flush_data (gsize * out_len)
+{
+  gsize i;
+
+  g_string_truncate (out_buf, 0);
+
+  for (i = 0; i < carry->len; i++)
+    append_invalid (out_buf, carry->str[i]);
+  g_string_truncate (carry, 0);
+
+  if (conv != (GIConv) -1)
+    {
+      gchar obuf[64], *outbuf = obuf;
+      gsize outleft = sizeof (obuf);
+
+      g_iconv (conv, NULL, NULL, &outbuf, &outleft);
+      g_string_append_len (out_buf, obuf, outbuf - obuf);
+    }
 
-      if (string->str[0] == '\014')
+  *out_len = out_buf->len;
+  return out_buf->str;
+}
+
+/* ANSI escape sequences handling */
+#define ANSI_BOLD       (1 << 0)
+#define ANSI_ITALIC     (1 << 1)
+#define ANSI_UNDERLINE  (1 << 2)
+#define ANSI_STRIKE     (1 << 3)
+#define ANSI_INVERSE    (1 << 4)
+
+#define ANSI_COLOR_INDEX  0x01000000
+#define ANSI_COLOR_RGB    0x02000000
+
+#define ANSI_MAX_PARAMS 32
+#define ANSI_MAX_SEQ    256
+
+typedef struct {
+  guint32 fore;
+  guint32 back;
+  guint flags;
+} AnsiAttr;
+
+static const gchar *ansi_colors[] = {
+  "#000000", "#cd0000", "#00cd00", "#cdcd00", "#0000ee", "#cd00cd", "#00cdcd", "#e5e5e5",
+  "#7f7f7f", "#ff0000", "#00ff00", "#ffff00", "#5c5cff", "#ff00ff", "#00ffff", "#ffffff"
+};
+
+static AnsiAttr ansi_attr = { 0, 0, 0 };
+static GtkTextTag *ansi_tag = NULL;
+static GHashTable *ansi_tags = NULL;
+static GString *ansi_buf = NULL;
+static GString *ansi_carry = NULL;
+
+static guint
+ansi_attr_hash (gconstpointer key)
+{
+  const AnsiAttr *a = key;
+  return a->fore * 31 + a->back * 17 + a->flags;
+}
+
+static gboolean
+ansi_attr_equal (gconstpointer a, gconstpointer b)
+{
+  return memcmp (a, b, sizeof (AnsiAttr)) == 0;
+}
+
+static gchar *
+ansi_color_string (guint32 color)
+{
+  if (color & ANSI_COLOR_RGB)
+    return g_strdup_printf ("#%06x", color & 0xffffff);
+  else
+    {
+      guint n = color & 0xff;
+
+      if (n < 16)
+        return g_strdup (ansi_colors[n]);
+      else if (n < 232)
         {
-          GtkTextIter start, end;
+          /* 6x6x6 color cube */
+          const guint lv[] = { 0x00, 0x5f, 0x87, 0xaf, 0xd7, 0xff };
 
-          /* clear text if ^L received */
-          gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (text_buffer), &start);
-          gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (text_buffer), &end);
-          gtk_text_buffer_delete (GTK_TEXT_BUFFER (text_buffer), &start, &end);
+          n -= 16;
+          return g_strdup_printf ("#%02x%02x%02x", lv[n / 36], lv[(n / 6) % 6], lv[n % 6]);
         }
-      else if (string->len > 0)
+      else
+        {
+          /* grayscale */
+          guint l = 8 + (n - 232) * 10;
+          return g_strdup_printf ("#%02x%02x%02x", l, l, l);
+        }
+    }
+}
+
+/* returns cached tag for current attributes. new tags are created on demand */
+static GtkTextTag *
+get_ansi_tag (void)
+{
+  GtkTextTag *t;
+  AnsiAttr *key;
+  guint32 fore, back;
+
+  if (ansi_attr.fore == 0 && ansi_attr.back == 0 && ansi_attr.flags == 0)
+    return NULL;
+
+  t = g_hash_table_lookup (ansi_tags, &ansi_attr);
+  if (t)
+    return t;
+
+  t = gtk_text_buffer_create_tag (GTK_TEXT_BUFFER (text_buffer), NULL, NULL);
+
+  fore = ansi_attr.fore;
+  back = ansi_attr.back;
+  if (ansi_attr.flags & ANSI_INVERSE)
+    {
+      fore = ansi_attr.back;
+      back = ansi_attr.fore;
+      /* swap default colors too */
+      if (fore == 0)
+        g_object_set (G_OBJECT (t), "foreground", options.text_data.back ? options.text_data.back : "white", NULL);
+      if (back == 0)
+        g_object_set (G_OBJECT (t), "background", options.text_data.fore ? options.text_data.fore : "black", NULL);
+    }
+
+  if (fore)
+    {
+      gchar *clr = ansi_color_string (fore);
+      g_object_set (G_OBJECT (t), "foreground", clr, NULL);
+      g_free (clr);
+    }
+  if (back)
+    {
+      gchar *clr = ansi_color_string (back);
+      g_object_set (G_OBJECT (t), "background", clr, NULL);
+      g_free (clr);
+    }
+  if (ansi_attr.flags & ANSI_BOLD)
+    g_object_set (G_OBJECT (t), "weight", PANGO_WEIGHT_BOLD, NULL);
+  if (ansi_attr.flags & ANSI_ITALIC)
+    g_object_set (G_OBJECT (t), "style", PANGO_STYLE_ITALIC, NULL);
+  if (ansi_attr.flags & ANSI_UNDERLINE)
+    g_object_set (G_OBJECT (t), "underline", PANGO_UNDERLINE_SINGLE, NULL);
+  if (ansi_attr.flags & ANSI_STRIKE)
+    g_object_set (G_OBJECT (t), "strikethrough", TRUE, NULL);
+
+  /* search highlighting must be above colors */
+  gtk_text_tag_set_priority (search_tag, gtk_text_tag_get_priority (t));
+
+  key = g_new (AnsiAttr, 1);
+  *key = ansi_attr;
+  g_hash_table_insert (ansi_tags, key, t);
+
+  return t;
+}
+
+static guint32
+parse_extended_color (gint * params, gint n, gint * i)
+{
+  /* 38;5;N or 38;2;R;G;B */
+  if (*i + 2 < n && params[*i + 1] == 5)
+    {
+      *i += 2;
+      return ANSI_COLOR_INDEX | (params[*i] & 0xff);
+    }
+  else if (*i + 4 < n && params[*i + 1] == 2)
+    {
+      guint32 clr = ANSI_COLOR_RGB | ((params[*i + 2] & 0xff) << 16) | ((params[*i + 3] & 0xff) << 8) | (params[*i + 4] & 0xff);
+      *i += 4;
+      return clr;
+    }
+  *i = n;
+  return 0;
+}
+
+static void
+apply_sgr (const gchar * s, const gchar * e)
+{
+  gint params[ANSI_MAX_PARAMS];
+  gint i, n = 0, v = 0;
+
+  for (; s <= e; s++)
+    {
+      if (s == e || *s == ';' || *s == ':')
+        {
+          if (n < ANSI_MAX_PARAMS)
+            params[n++] = v;
+          v = 0;
+        }
+      else if (g_ascii_isdigit (*s))
+        v = v * 10 + (*s - '0');
+    }
+
+  for (i = 0; i < n; i++)
+    {
+      gint p = params[i];
+
+      if (p == 0)
+        {
+          ansi_attr.fore = ansi_attr.back = 0;
+          ansi_attr.flags = 0;
+        }
+      else if (p == 1)
+        ansi_attr.flags |= ANSI_BOLD;
+      else if (p == 3)
+        ansi_attr.flags |= ANSI_ITALIC;
+      else if (p == 4)
+        ansi_attr.flags |= ANSI_UNDERLINE;
+      else if (p == 7)
+        ansi_attr.flags |= ANSI_INVERSE;
+      else if (p == 9)
+        ansi_attr.flags |= ANSI_STRIKE;
+      else if (p == 22)
+        ansi_attr.flags &= ~ANSI_BOLD;
+      else if (p == 23)
+        ansi_attr.flags &= ~ANSI_ITALIC;
+      else if (p == 24)
+        ansi_attr.flags &= ~ANSI_UNDERLINE;
+      else if (p == 27)
+        ansi_attr.flags &= ~ANSI_INVERSE;
+      else if (p == 29)
+        ansi_attr.flags &= ~ANSI_STRIKE;
+      else if (p >= 30 && p <= 37)
+        ansi_attr.fore = ANSI_COLOR_INDEX | (p - 30);
+      else if (p == 38)
+        ansi_attr.fore = parse_extended_color (params, n, &i);
+      else if (p == 39)
+        ansi_attr.fore = 0;
+      else if (p >= 40 && p <= 47)
+        ansi_attr.back = ANSI_COLOR_INDEX | (p - 40);
+      else if (p == 48)
+        ansi_attr.back = parse_extended_color (params, n, &i);
+      else if (p == 49)
+        ansi_attr.back = 0;
+      else if (p >= 90 && p <= 97)
+        ansi_attr.fore = ANSI_COLOR_INDEX | (p - 90 + 8);
+      else if (p >= 100 && p <= 107)
+        ansi_attr.back = ANSI_COLOR_INDEX | (p - 100 + 8);
+    }
+
+  ansi_tag = get_ansi_tag ();
+}
+
+/* parse escape sequence started at p. returns pointer to the next character
+ * after sequence or NULL if sequence is incomplete */
+static const gchar *
+parse_escape (const gchar * p, const gchar * e)
+{
+  const gchar *q;
+
+  if (e - p < 2)
+    return NULL;
+
+  if (p[1] == '[')
+    {
+      /* CSI - parameters, intermediate bytes and final byte */
+      for (q = p + 2; q < e && *q >= 0x20 && *q <= 0x3f; q++);
+      if (q == e)
+        return (e - p < ANSI_MAX_SEQ) ? NULL : e;
+      if (*q == 'm')
+        apply_sgr (p + 2, q);
+      return q + 1;
+    }
+  else if (p[1] == ']')
+    {
+      /* OSC - terminated by BEL or ST */
+      for (q = p + 2; q < e; q++)
         {
-          GtkTextIter end;
+          if (*q == '\007')
+            return q + 1;
+          if (*q == '\033' && q + 1 < e && q[1] == '\\')
+            return q + 2;
+        }
+      return (e - p < ANSI_MAX_SEQ) ? NULL : e;
+    }
+
+  return p + 2;
+}
+
+static void
+buffer_append (const gchar * text, gsize len, GtkTextTag * t)
+{
+  GtkTextIter end;
+
+  if (len == 0)
+    return;
+
+  gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (text_buffer), &end);
+  if (t)
+    gtk_text_buffer_insert_with_tags (GTK_TEXT_BUFFER (text_buffer), &end, text, len, t, NULL);
+  else
+    gtk_text_buffer_insert (GTK_TEXT_BUFFER (text_buffer), &end, text, len);
+}
+
+/* long lines guard */
+#define SPLIT_MARKER "\n\342\206\252 "
+#define TRUNC_MARKER " [\342\200\246]"
+
+typedef struct {
+  GtkTextMark *mark;
+  GString *tail;
+} TruncatedLine;
+
+static GtkTextTag *guard_tag = NULL;
+static glong line_len = 0;
+static GSList *truncated = NULL;
+static GString *trunc_tail = NULL;
+
+static void
+reset_line_guard (void)
+{
+  GSList *l;
+
+  for (l = truncated; l; l = l->next)
+    {
+      TruncatedLine *tl = l->data;
+
+      gtk_text_buffer_delete_mark (GTK_TEXT_BUFFER (text_buffer), tl->mark);
+      g_string_free (tl->tail, TRUE);
+      g_free (tl);
+    }
+  g_slist_free (truncated);
+  truncated = NULL;
+  trunc_tail = NULL;
+  line_len = 0;
+}
+
+static void
+start_truncation (void)
+{
+  TruncatedLine *tl;
+  GtkTextIter end;
+
+  buffer_append (TRUNC_MARKER, strlen (TRUNC_MARKER), guard_tag);
+
+  /* the rest of line is kept aside and restored in output */
+  tl = g_new0 (TruncatedLine, 1);
+  gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (text_buffer), &end);
+  tl->mark = gtk_text_buffer_create_mark (GTK_TEXT_BUFFER (text_buffer), NULL, &end, TRUE);
+  tl->tail = g_string_new (NULL);
+  truncated = g_slist_prepend (truncated, tl);
+
+  trunc_tail = tl->tail;
+}
+
+/* insert text to the end of buffer, splitting or truncating too long lines.
+ * gtk text layout is very slow on a huge paragraphs */
+static void
+insert_run (const gchar * text, gsize len, GtkTextTag * t)
+{
+  const gchar *p = text, *run, *e = text + len;
+  glong max = options.text_data.max_line;
+
+  if (max <= 0)
+    {
+      buffer_append (text, len, t);
+      return;
+    }
+
+  if (trunc_tail)
+    {
+      const gchar *nl = memchr (p, '\n', len);
 
-          gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (text_buffer), &end);
+      g_string_append_len (trunc_tail, p, (nl ? nl : e) - p);
+      if (nl == NULL)
+        return;
+      trunc_tail = NULL;
+      p = nl;
+    }
 
-          if (!g_utf8_validate (string->str, string->len, NULL))
+  run = p;
+  while (p < e)
+    {
+      const gchar *nl = memchr (p, '\n', e - p);
+      const gchar *le = nl ? nl : e;
+      glong chars = g_utf8_strlen (p, le - p);
+
+      if (line_len + chars <= max)
+        {
+          if (nl)
             {
-              gchar *utftext =
-                g_convert_with_fallback (string->str, string->len, "UTF-8", "ISO-8859-1", NULL, NULL, NULL, NULL);
-              gtk_text_buffer_insert (GTK_TEXT_BUFFER (text_buffer), &end, utftext, -1);
-              g_free (utftext);
+              line_len = 0;
+              p = nl + 1;
             }
           else
-            gtk_text_buffer_insert (GTK_TEXT_BUFFER (text_buffer), &end, string->str, string->len);
-
-          if (options.common_data.tail)
             {
-              while (gtk_events_pending ())
-                gtk_main_iteration ();
-              gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (text_buffer), &end);
-              gtk_text_view_scroll_to_iter (GTK_TEXT_VIEW (text_view), &end, 0, FALSE, 0, 0);
+              line_len += chars;
+              p = e;
             }
+          continue;
+        }
+
+      /* cut line at the limit */
+      p = g_utf8_offset_to_pointer (p, max - line_len);
+      buffer_append (run, p - run, t);
+
+      if (options.text_data.truncate_lines)
+        {
+          start_truncation ();
+          g_string_append_len (trunc_tail, p, le - p);
+          if (nl == NULL)
+            return;
+          trunc_tail = NULL;
+          p = nl;
+        }
+      else
+        buffer_append (SPLIT_MARKER, strlen (SPLIT_MARKER), guard_tag);
+
+      line_len = 0;
+      run = p;
+    }
+
+  buffer_append (run, e - run, t);
+}
+
+/* strip escape sequences and insert text by runs with the same attributes */
+static void
+insert_ansi_text (const gchar * text, gsize len)
+{
+  const gchar *p, *run, *e;
+
+  if (ansi_carry->len > 0)
+    {
+      g_string_truncate (ansi_buf, 0);
+      g_string_append_len (ansi_buf, ansi_carry->str, ansi_carry->len);
+      g_string_append_len (ansi_buf, text, len);
+      g_string_truncate (ansi_carry, 0);
+      text = ansi_buf->str;
+      len = ansi_buf->len;
+    }
+
+  p = run = text;
+  e = text + len;
+  while ((p = memchr (p, '\033', e - p)) != NULL)
+    {
+      const gchar *q;
+
+      insert_run (run, p - run, ansi_tag);
+
+      q = parse_escape (p, e);
+      if (q == NULL)
+        {
+          /* wait for the rest of sequence */
+          g_string_append_len (ansi_carry, p, e - p);
+          return;
+        }
+      p = run = q;
+    }
+  insert_run (run, e - run, ansi_tag);
+}
+
+static void
+insert_text (const gchar * text, gsize len)
+{
+  if (options.text_data.ansi)
+    insert_ansi_text (text, len);
+  else
+    insert_run (text, len, NULL);
+}
+
+static void
+insert_stdin_text (const gchar * text, gsize len)
+{
+  const gchar *p, *ff = NULL, *e = text + len;
+
+  if (len == 0)
+    return;
+
+  if (skip_line)
+    {
+      p = memchr (text, '\n', len);
+      if (p == NULL)
+        return;
+      text = p + 1;
+      skip_line = FALSE;
+      at_line_start = TRUE;
+    }
+
+  /* find last ^L at the beginning of line */
+  p = text;
+  while ((p = memchr (p, '\014', e - p)) != NULL)
+    {
+      if (p == text ? at_line_start : p[-1] == '\n')
+        ff = p;
+      p++;
+    }
+
+  if (ff)
+    {
+      GtkTextIter start, end;
+
+      /* clear text if ^L received */
+      gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (text_buffer), &start, &end);
+      gtk_text_buffer_delete (GTK_TEXT_BUFFER (text_buffer), &start, &end);
+      reset_line_guard ();
+
+      /* and skip the rest of that line */
+      p = memchr (ff, '\n', e - ff);
+      if (p == NULL)
+        {
+          skip_line = TRUE;
+          return;
+        }
+      text = p + 1;
+      at_line_start = TRUE;
+    }
+
+  if (text < e)
+    {
+      insert_text (text, e - text);
+      at_line_start = (e[-1] == '\n');
+    }
+}
+
+static void
+scroll_to_end (void)
+{
+  GtkTextIter end;
+
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+  gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (text_buffer), &end);
+  gtk_text_view_scroll_to_iter (GTK_TEXT_VIEW (text_view), &end, 0, FALSE, 0, 0);
+}
+
+/* read file from current position to the end. returns number of read bytes */
+static gsize
+read_file_data (gint fd)
+{
+  static gchar *buf = NULL;
+  const gchar *text;
+  gssize count;
+  gsize len, total = 0;
+
+  if (buf == NULL)
+    buf = g_malloc (READ_BLOCK_SIZE);
+
+  while ((count = read (fd, buf, READ_BLOCK_SIZE)) > 0)
+    {
+      text = decode_data (buf, count, &len);
+      insert_text (text, len);
+      total += count;
+    }
+
+  return total;
+}
+
+static gboolean
+handle_stdin (GIOChannel * channel, GIOCondition condition, gpointer data)
+{
+  static gchar buf[READ_BLOCK_SIZE];
+  GIOStatus status = G_IO_STATUS_NORMAL;
+  GError *err = NULL;
+  const gchar *text;
+  gsize n, len;
+  gint i;
+
+  /* read all available data, but not too much at once for keep ui responsive */
+  for (i = 0; i < MAX_READ_BLOCKS; i++)
+    {
+      status = g_io_channel_read_chars (channel, buf, READ_BLOCK_SIZE, &n, &err);
+      if (n > 0)
+        {
+          text = decode_data (buf, n, &len);
+          insert_stdin_text (text, len);
         }
+      if (status != G_IO_STATUS_NORMAL)
+        break;
+    }
 
-      g_string_free (string, TRUE);
+  if (status == G_IO_STATUS_ERROR || status == G_IO_STATUS_EOF)
+    {
+      if (err)
+        {
+          g_printerr ("yad_text_handle_stdin(): %s\n", err->message);
+          g_error_free (err);
+          err = NULL;
+        }
+
+      text = flush_data (&len);
+      insert_stdin_text (text, len);
+
+      /* stop handling */
+      g_io_channel_shutdown (channel, TRUE, NULL);
     }
 
+  if (options.common_data.tail)
+    scroll_to_end ();
+
 #ifdef HAVE_SOURCEVIEW
   if (options.source_data.lang)
     {
@@ -365,66 +1233,153 @@ handle_stdin (GIOChannel * channel, GIOCondition condition, gpointer data)
     }
 #endif
 
-  return TRUE;
+  return (status != G_IO_STATUS_ERROR && status != G_IO_STATUS_EOF);
+}
+
+#ifdef HAVE_GIO
+static void
+read_stream_data (GInputStream * stream)
+{
+  static gchar *buf = NULL;
+  const gchar *text;
+  GError *err = NULL;
+  gssize count;
+  gsize len;
+
+  if (buf == NULL)
+    buf = g_malloc (READ_BLOCK_SIZE);
+
+  while ((count = g_input_stream_read (stream, buf, READ_BLOCK_SIZE, NULL, &err)) > 0)
+    {
+      text = decode_data (buf, count, &len);
+      insert_text (text, len);
+    }
+
+  if (err)
+    {
+      g_printerr (_("Cannot read file '%s': %s\n"), options.common_data.uri, err->message);
+      g_error_free (err);
+    }
 }
 
+static gint follow_fd = -1;
+static goffset follow_ofs = 0;
+
+static void
+file_changed_cb (GFileMonitor * mon, GFile * file, GFile * ofile, GFileMonitorEvent ev, gpointer data)
+{
+  struct stat st, fst;
+  gboolean changed = FALSE;
+
+  if (follow_fd != -1)
+    {
+      if (fstat (follow_fd, &fst) == 0 && fst.st_size < follow_ofs)
+        {
+          /* file was truncated - start from the beginning */
+          lseek (follow_fd, 0, SEEK_SET);
+          follow_ofs = 0;
+        }
+      follow_ofs += read_file_data (follow_fd);
+      changed = TRUE;
+    }
+
+  /* file was removed, wait until it appears again */
+  if (stat (options.common_data.uri, &st) != 0)
+    return;
+
+  if (follow_fd == -1 || fstat (follow_fd, &fst) != 0 || st.st_ino != fst.st_ino || st.st_dev != fst.st_dev)
+    {
+      /* file was rotated - reopen it */
+      if (follow_fd != -1)
+        {
+          const gchar *text;
+          gsize len;
+
+          text = flush_data (&len);
+          insert_text (text, len);
+          close (follow_fd);
+        }
+
+      follow_fd = open (options.common_data.uri, O_RDONLY);
+      follow_ofs = 0;
+      if (follow_fd != -1)
+        follow_ofs = read_file_data (follow_fd);
+      changed = TRUE;
+    }
+
+  if (changed && options.common_data.tail)
+    scroll_to_end ();
+}
+#endif
+
 static void
 fill_buffer_from_file ()
 {
-  GtkTextIter iter, end;
 #ifdef HAVE_SOURCEVIEW
   GtkSourceLanguage *lang;
 #endif
-  FILE *f;
-  gchar buf[2048];
-  gint remaining = 0;
+#ifdef HAVE_GIO
+  GInputStream *stream;
+#endif
+  gboolean follow = FALSE;
 
   if (options.common_data.uri == NULL)
     return;
 
-  f = fopen (options.common_data.uri, "r");
-
-  if (f == NULL)
+#ifdef HAVE_GIO
+  /* compressed files are unpacked on the fly */
+  stream = open_compressed_file (options.common_data.uri);
+  if (stream)
     {
-      g_printerr (_("Cannot open file '%s': %s\n"), options.common_data.uri, g_strerror (errno));
-      return;
+      read_stream_data (stream);
+      g_object_unref (stream);
     }
-
-  gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (text_buffer), &iter, 0);
-
-  while (!feof (f))
+  else
+#endif
     {
-      gint count;
-      const char *leftover;
-      int to_read = 2047 - remaining;
+      gint fd;
+      gsize count;
 
-      count = fread (buf + remaining, 1, to_read, f);
-      buf[count + remaining] = '\0';
+      fd = open (options.common_data.uri, O_RDONLY);
+      if (fd == -1)
+        {
+          g_printerr (_("Cannot open file '%s': %s\n"), options.common_data.uri, g_strerror (errno));
+          return;
+        }
 
-      g_utf8_validate (buf, count + remaining, &leftover);
+      count = read_file_data (fd);
 
-      g_assert (g_utf8_validate (buf, leftover - buf, NULL));
-      gtk_text_buffer_insert (GTK_TEXT_BUFFER (text_buffer), &iter, buf, leftover - buf);
+#ifdef HAVE_GIO
+      if (options.text_data.follow)
+        {
+          GFile *file = g_file_new_for_path (options.common_data.uri);
+          GFileMonitor *mon = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, NULL);
 
-      remaining = (buf + remaining + count) - leftover;
-      memmove (buf, leftover, remaining);
+          if (mon)
+            {
+              follow_fd = fd;
+              follow_ofs = count;
+              follow = TRUE;
+              g_file_monitor_set_rate_limit (mon, 100);
+              g_signal_connect (G_OBJECT (mon), "changed", G_CALLBACK (file_changed_cb), NULL);
+            }
+          g_object_unref (file);
+        }
+#endif
 
-      if (remaining > 6 || count < to_read)
-        break;
+      if (!follow)
+        close (fd);
     }
 
-  if (remaining)
+  if (!follow)
     {
-      g_printerr (_("Invalid UTF-8 data encountered reading file %s\n"), options.common_data.uri);
-      return;
-    }
+      const gchar *text;
+      gsize len;
 
-  /* We had a newline in the buffer to begin with. (The buffer always contains
-   * a newline, so we delete to the end of the buffer to clean up.
-   */
+      text = flush_data (&len);
+      insert_text (text, len);
+    }
 
-  gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (text_buffer), &end);
-  gtk_text_buffer_delete (GTK_TEXT_BUFFER (text_buffer), &iter, &end);
   gtk_text_buffer_set_modified (GTK_TEXT_BUFFER (text_buffer), FALSE);
 
 #ifdef HAVE_SOURCEVIEW
@@ -564,6 +1519,11 @@ text_create_widget (GtkWidget * dlg)
   /* Add submit on ctrl+enter */
   g_signal_connect (text_view, "key-press-event", G_CALLBACK (key_press_cb), dlg);
 
+  /* Initialize searching */
+  matches = g_array_new (FALSE, FALSE, sizeof (SearchMatch));
+  search_tag = gtk_text_buffer_create_tag (GTK_TEXT_BUFFER (text_buffer), NULL, "background", "yellow", NULL);
+  g_signal_connect (G_OBJECT (text_buffer), "changed", G_CALLBACK (buffer_changed_cb), NULL);
+
   /* Initialize linkifying */
   if (options.text_data.uri)
     {
@@ -590,6 +1550,31 @@ text_create_widget (GtkWidget * dlg)
 
   gtk_container_add (GTK_CONTAINER (w), text_view);
 
+  /* Initialize long lines guard */
+  if (options.text_data.max_line > 0)
+    guard_tag = gtk_text_buffer_create_tag (GTK_TEXT_BUFFER (text_buffer), NULL, "foreground", "gray", NULL);
+
+  /* Initialize ANSI sequences parsing */
+  if (options.text_data.ansi)
+    {
+      ansi_tags = g_hash_table_new_full (ansi_attr_hash, ansi_attr_equal, g_free, NULL);
+      ansi_buf = g_string_new (NULL);
+      ansi_carry = g_string_new (NULL);
+    }
+
+  /* Initialize input decoding */
+  in_buf = g_string_sized_new (READ_BLOCK_SIZE);
+  out_buf = g_string_sized_new (READ_BLOCK_SIZE);
+  carry = g_string_new (NULL);
+  if (options.common_data.encoding &&
+      g_ascii_strcasecmp (options.common_data.encoding, "UTF-8") != 0 &&
+      g_ascii_strcasecmp (options.common_data.encoding, "UTF8") != 0)
+    {
+      conv = g_iconv_open ("UTF-8", options.common_data.encoding);
+      if (conv == (GIConv) -1)
+        g_printerr (_("Unknown encoding: %s\n"), options.common_data.encoding);
+    }
+
   if (options.common_data.uri)
     fill_buffer_from_file ();
 
@@ -617,6 +1602,61 @@ text_print_result (void)
     return;
 
   gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (text_buffer), &start, &end);
+
+  if (guard_tag)
+    {
+      GString *str;
+      GSList *lines, *tl;
+      GtkTextIter next;
+
+      /* restore original text without markers */
+      str = g_string_new (NULL);
+      tl = lines = g_slist_reverse (g_slist_copy (truncated));
+      while (!gtk_text_iter_is_end (&start))
+        {
+          gboolean hidden = gtk_text_iter_has_tag (&start, guard_tag);
+
+          next = start;
+          gtk_text_iter_forward_to_tag_toggle (&next, guard_tag);
+
+          for (; tl; tl = tl->next)
+            {
+              TruncatedLine *l = tl->data;
+              GtkTextIter m;
+
+              gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (text_buffer), &m, l->mark);
+              if (gtk_text_iter_compare (&m, &next) > 0)
+                break;
+              if (!hidden)
+                {
+                  text = gtk_text_iter_get_text (&start, &m);
+                  g_string_append (str, text);
+                  g_free (text);
+                }
+              start = m;
+              g_string_append_len (str, l->tail->str, l->tail->len);
+            }
+
+          if (!hidden)
+            {
+              text = gtk_text_iter_get_text (&start, &next);
+              g_string_append (str, text);
+              g_free (text);
+            }
+          start = next;
+        }
+      for (; tl; tl = tl->next)
+        {
+          TruncatedLine *l = tl->data;
+          g_string_append_len (str, l->tail->str, l->tail->len);
+        }
+
+      g_print ("%s", str->str);
+      g_string_free (str, TRUE);
+      g_slist_free (lines);
+      return;
+    }
+
   text = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (text_buffer), &start, &end, 0);
   g_print ("%s", text);
   g_free (text);
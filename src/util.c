@@ -24,9 +24,23 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 
 #include "yad.h"
 
@@ -149,31 +163,148 @@ write_settings (void)
   g_free (context);
 }
 
-GdkPixbuf *
-get_pixbuf (gchar * name, YadIconSize size)
+/* process-wide cache of loaded images */
+#define PIXBUF_CACHE_SIZE (16 * 1024 * 1024)    /* bytes */
+#define PIXBUF_CACHE_MAX_ITEM (PIXBUF_CACHE_SIZE / 8)
+
+typedef struct {
+  gchar *key;
+  GdkPixbuf *pixbuf;
+  gsize bytes;
+  time_t mtime;
+  off_t size;
+  GList *link;
+} PixbufCacheItem;
+
+static GHashTable *pixbuf_cache = NULL;
+static GQueue pixbuf_lru = G_QUEUE_INIT;
+static gsize pixbuf_cache_bytes = 0;
+static guint pixbuf_hits = 0, pixbuf_misses = 0;
+
+static void
+pixbuf_cache_stats (void)
+{
+  g_debug ("pixbuf cache: %u hits, %u misses, %u items, %" G_GSIZE_FORMAT " bytes",
+           pixbuf_hits, pixbuf_misses, g_hash_table_size (pixbuf_cache), pixbuf_cache_bytes);
+}
+
+static void
+pixbuf_cache_remove (PixbufCacheItem * item)
+{
+  g_queue_delete_link (&pixbuf_lru, item->link);
+  pixbuf_cache_bytes -= item->bytes;
+  g_hash_table_remove (pixbuf_cache, item->key);
+}
+
+static void
+pixbuf_cache_free (PixbufCacheItem * item)
+{
+  g_free (item->key);
+  g_object_unref (item->pixbuf);
+  g_free (item);
+}
+
+static void
+pixbuf_cache_add (gchar * key, GdkPixbuf * pb, struct stat *st)
+{
+  PixbufCacheItem *item;
+  gsize bytes;
+
+  bytes = (gsize) gdk_pixbuf_get_rowstride (pb) * gdk_pixbuf_get_height (pb);
+  if (bytes > PIXBUF_CACHE_MAX_ITEM)
+    {
+      g_free (key);
+      return;
+    }
+
+  item = g_new0 (PixbufCacheItem, 1);
+  item->key = key;
+  item->pixbuf = g_object_ref (pb);
+  item->bytes = bytes;
+  if (st)
+    {
+      item->mtime = st->st_mtime;
+      item->size = st->st_size;
+    }
+  g_queue_push_head (&pixbuf_lru, item);
+  item->link = pixbuf_lru.head;
+  g_hash_table_insert (pixbuf_cache, item->key, item);
+  pixbuf_cache_bytes += bytes;
+
+  /* drop least recently used images */
+  while (pixbuf_cache_bytes > PIXBUF_CACHE_SIZE)
+    pixbuf_cache_remove (g_queue_peek_tail (&pixbuf_lru));
+}
+
+/* load image from file. If icon_size is set, bigger images are scaled down on decoding */
+static GdkPixbuf *
+load_pixbuf_file (gchar * name, gint icon_size)
+{
+  GdkPixbuf *pb;
+  GError *err = NULL;
+  gint w, h;
+
+  if (icon_size > 0 && gdk_pixbuf_get_file_info (name, &w, &h) && (w > icon_size || h > icon_size))
+    pb = gdk_pixbuf_new_from_file_at_scale (name, icon_size, icon_size, TRUE, &err);
+  else
+    pb = gdk_pixbuf_new_from_file (name, &err);
+
+  if (!pb)
+    {
+      g_printerr ("yad_get_pixbuf(): %s\n", err->message);
+      g_error_free (err);
+    }
+
+  return pb;
+}
+
+/* returns new reference to image. Images from files are scaled to icon size if fit is set,
+ * otherwise they are loaded in original size */
+static GdkPixbuf *
+load_pixbuf (gchar * name, YadIconSize size, gboolean fit)
 {
   gint w, h;
+  gchar *key;
+  struct stat st;
+  gboolean is_file;
+  PixbufCacheItem *item;
   GdkPixbuf *pb = NULL;
-  GError *err = NULL;
 
-  if (g_file_test (name, G_FILE_TEST_EXISTS))
+  if (pixbuf_cache == NULL)
     {
-      pb = gdk_pixbuf_new_from_file (name, &err);
-      if (!pb)
-        {
-          g_printerr ("yad_get_pixbuf(): %s\n", err->message);
-          g_error_free (err);
-        }
+      pixbuf_cache = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) pixbuf_cache_free);
+      atexit (pixbuf_cache_stats);
     }
+
+  if (size == YAD_BIG_ICON)
+    gtk_icon_size_lookup (GTK_ICON_SIZE_DIALOG, &w, &h);
   else
-    {
-      if (size == YAD_BIG_ICON)
-        gtk_icon_size_lookup (GTK_ICON_SIZE_DIALOG, &w, &h);
-      else
-        gtk_icon_size_lookup (GTK_ICON_SIZE_MENU, &w, &h);
+    gtk_icon_size_lookup (GTK_ICON_SIZE_MENU, &w, &h);
+
+  is_file = (stat (name, &st) == 0);
 
-      pb = gtk_icon_theme_load_icon (settings.icon_theme, name, MIN (w, h), GTK_ICON_LOOKUP_GENERIC_FALLBACK, NULL);
+  /* icons from theme are the same in both cases */
+  fit = fit && is_file;
+  key = g_strdup_printf ("%d:%d:%s", size, fit, name);
+  item = g_hash_table_lookup (pixbuf_cache, key);
+  if (item && (!is_file || (item->mtime == st.st_mtime && item->size == st.st_size)))
+    {
+      pixbuf_hits++;
+      g_free (key);
+      /* move to the head of lru list */
+      g_queue_unlink (&pixbuf_lru, item->link);
+      g_queue_push_head_link (&pixbuf_lru, item->link);
+      return g_object_ref (item->pixbuf);
     }
+  /* outdated file image */
+  if (item)
+    pixbuf_cache_remove (item);
+  pixbuf_misses++;
+
+  if (is_file)
+    pb = load_pixbuf_file (name, fit ? MIN (w, h) : 0);
+  else
+    pb = gtk_icon_theme_load_icon (settings.icon_theme, name, MIN (w, h), GTK_ICON_LOOKUP_GENERIC_FALLBACK, NULL);
 
   if (!pb)
     {
@@ -181,11 +312,34 @@ get_pixbuf (gchar * name, YadIconSize size)
         pb = settings.big_fallback_image;
       else
         pb = settings.small_fallback_image;
+
+      if (pb == NULL)
+        {
+          g_free (key);
+          return NULL;
+        }
+      g_object_ref (pb);
     }
 
+  pixbuf_cache_add (key, pb, is_file ? &st : NULL);
+
   return pb;
 }
 
+/* returns new reference to image. Images from files have original size */
+GdkPixbuf *
+get_pixbuf (gchar * name, YadIconSize size)
+{
+  return load_pixbuf (name, size, FALSE);
+}
+
+/* returns new reference to icon. Big images from files are scaled down to icon size */
+GdkPixbuf *
+get_icon_pixbuf (gchar * name, YadIconSize size)
+{
+  return load_pixbuf (name, size, TRUE);
+}
+
 gchar *
 get_color (GdkColor *c, guint64 alpha)
 {
@@ -225,71 +379,340 @@ get_color (GdkColor *c, guint64 alpha)
   return res;
 }
 
-void
-update_preview (GtkFileChooser * chooser, GtkWidget *p)
-{
+/* previews are made in separate thread according to freedesktop thumbnails spec */
+#define PREVIEW_SIZE 256
+#define PREVIEW_PREFETCH 2
+#define PREVIEW_CHUNK 65536
+
+typedef struct {
+  gint gen;
   gchar *uri;
-  static gchar *normal_path = NULL;
-  static gchar *large_path = NULL;
+  GtkFileChooser *chooser;
+  GtkWidget *image;
+  GdkPixbuf *pixbuf;
+} PreviewJob;
+
+static GThreadPool *preview_pool = NULL;
+static volatile gint preview_gen = 0;
+static gchar *thumb_normal_path = NULL;
+static gchar *thumb_large_path = NULL;
+
+/* sorted listing of the last directory. Used only by preview thread */
+static gchar *prefetch_dir = NULL;
+static time_t prefetch_mtime = 0;
+static GPtrArray *prefetch_files = NULL;
+
+static GdkPixbuf *
+load_thumbnail (const gchar * file, const gchar * mtime)
+{
+  GdkPixbuf *pb;
+  const gchar *tm;
 
-  /* init thumbnails path */
-  if (!normal_path)
-    normal_path = g_build_filename (g_get_user_cache_dir (), "thumbnails", "normal", NULL);
-  if (!large_path)
-    large_path = g_build_filename (g_get_user_cache_dir (), "thumbnails", "large", NULL);
+  pb = gdk_pixbuf_new_from_file (file, NULL);
+  if (pb == NULL)
+    return NULL;
 
-  /* load preview */
-  uri = gtk_file_chooser_get_preview_uri (chooser);
-  if (uri)
-    {
-      gchar *file;
-      GChecksum *chs;
-      GdkPixbuf *pb;
-
-      chs = g_checksum_new (G_CHECKSUM_MD5);
-      g_checksum_update (chs, (const guchar *) uri, -1);
-      /* first try to get preview from large thumbnail */
-      file = g_strdup_printf ("%s/%s.png", large_path, g_checksum_get_string (chs));
-      if (g_file_test (file, G_FILE_TEST_EXISTS))
-        pb = gdk_pixbuf_new_from_file (file, NULL);
+  /* thumbnail is outdated */
+  tm = gdk_pixbuf_get_option (pb, "tEXt::Thumb::MTime");
+  if (tm == NULL || strcmp (tm, mtime) != 0)
+    {
+      g_object_unref (pb);
+      return NULL;
+    }
+
+  return pb;
+}
+
+static void
+save_thumbnail (GdkPixbuf * pb, const gchar * uri, const gchar * mtime, const gchar * sum)
+{
+  gchar *file, *tmp;
+
+  g_mkdir_with_parents (thumb_large_path, 0700);
+
+  file = g_strdup_printf ("%s/%s.png", thumb_large_path, sum);
+  tmp = g_strdup_printf ("%s.%d.tmp", file, getpid ());
+  if (gdk_pixbuf_save (pb, tmp, "png", NULL, "tEXt::Thumb::URI", uri, "tEXt::Thumb::MTime", mtime, NULL))
+    {
+      chmod (tmp, 0600);
+      rename (tmp, file);
+    }
+  else
+    unlink (tmp);
+
+  g_free (tmp);
+  g_free (file);
+}
+
+static void
+preview_size_prepared (GdkPixbufLoader * loader, gint w, gint h, gpointer data)
+{
+  /* let the decoder scale image down */
+  if (w > PREVIEW_SIZE || h > PREVIEW_SIZE)
+    {
+      if (w > h)
+        {
+          h = MAX (1, (gint64) h * PREVIEW_SIZE / w);
+          w = PREVIEW_SIZE;
+        }
       else
         {
-          /* try to get preview from normal thumbnail */
-          g_free (file);
-          file = g_strdup_printf ("%s/%s.png", normal_path, g_checksum_get_string (chs));
-          if (g_file_test (file, G_FILE_TEST_EXISTS))
-            pb = gdk_pixbuf_new_from_file (file, NULL);
-          else
+          w = MAX (1, (gint64) w * PREVIEW_SIZE / h);
+          h = PREVIEW_SIZE;
+        }
+      gdk_pixbuf_loader_set_size (loader, w, h);
+    }
+}
+
+/* decode image by chunks. Decoding stops if request is superseded */
+static GdkPixbuf *
+load_preview_image (const gchar * filename, gint gen)
+{
+  GdkPixbufLoader *loader;
+  GdkPixbuf *pb = NULL;
+  guchar *buf;
+  gboolean ok = TRUE;
+  gssize len = 0;
+  gint fd;
+
+  if (!gdk_pixbuf_get_file_info (filename, NULL, NULL))
+    return NULL;
+
+  fd = open (filename, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  loader = gdk_pixbuf_loader_new ();
+  g_signal_connect (G_OBJECT (loader), "size-prepared", G_CALLBACK (preview_size_prepared), NULL);
+
+  buf = g_malloc (PREVIEW_CHUNK);
+  while (ok && (len = read (fd, buf, PREVIEW_CHUNK)) > 0)
+    {
+      if (gen != g_atomic_int_get (&preview_gen))
+        ok = FALSE;
+      else
+        ok = gdk_pixbuf_loader_write (loader, buf, len, NULL);
+    }
+  g_free (buf);
+  close (fd);
+
+  if (gdk_pixbuf_loader_close (loader, NULL) && ok && len == 0)
+    {
+      pb = gdk_pixbuf_loader_get_pixbuf (loader);
+      if (pb)
+        pb = gdk_pixbuf_apply_embedded_orientation (pb);
+    }
+  g_object_unref (loader);
+
+  return pb;
+}
+
+static GdkPixbuf *
+get_thumbnail (const gchar * uri, const gchar * filename, gint gen)
+{
+  struct stat st;
+  gchar *sum, *file, *mtime;
+  GdkPixbuf *pb;
+
+  if (stat (filename, &st) != 0 || !S_ISREG (st.st_mode))
+    return NULL;
+
+  mtime = g_strdup_printf ("%" G_GINT64_FORMAT, (gint64) st.st_mtime);
+  sum = g_compute_checksum_for_string (G_CHECKSUM_MD5, uri, -1);
+
+  /* first try to get preview from large thumbnail, then from normal */
+  file = g_strdup_printf ("%s/%s.png", thumb_large_path, sum);
+  pb = load_thumbnail (file, mtime);
+  g_free (file);
+  if (pb == NULL)
+    {
+      file = g_strdup_printf ("%s/%s.png", thumb_normal_path, sum);
+      pb = load_thumbnail (file, mtime);
+      g_free (file);
+    }
+
+  /* try to create it */
+  if (pb == NULL)
+    {
+      pb = load_preview_image (filename, gen);
+      if (pb)
+        save_thumbnail (pb, uri, mtime, sum);
+    }
+
+  g_free (mtime);
+  g_free (sum);
+
+  return pb;
+}
+
+static gint
+compare_names (gconstpointer a, gconstpointer b)
+{
+  return g_ascii_strcasecmp (*(gchar **) a, *(gchar **) b);
+}
+
+/* make thumbnails for files around the current one */
+static void
+prefetch_neighbours (const gchar * filename, gint gen)
+{
+  struct stat st;
+  gchar *dir, *base;
+  gint i, d, idx = -1;
+
+  dir = g_path_get_dirname (filename);
+  if (stat (dir, &st) != 0)
+    {
+      g_free (dir);
+      return;
+    }
+
+  if (g_strcmp0 (dir, prefetch_dir) != 0 || st.st_mtime != prefetch_mtime)
+    {
+      GDir *gd;
+      const gchar *name;
+
+      if (prefetch_files)
+        g_ptr_array_free (prefetch_files, TRUE);
+      prefetch_files = g_ptr_array_new_with_free_func (g_free);
+      g_free (prefetch_dir);
+      prefetch_dir = g_strdup (dir);
+      prefetch_mtime = st.st_mtime;
+
+      gd = g_dir_open (dir, 0, NULL);
+      if (gd)
+        {
+          while ((name = g_dir_read_name (gd)) != NULL)
+            {
+              if (name[0] != '.' || options.common_data.show_hidden)
+                g_ptr_array_add (prefetch_files, g_strdup (name));
+            }
+          g_dir_close (gd);
+        }
+      g_ptr_array_sort (prefetch_files, compare_names);
+    }
+
+  base = g_path_get_basename (filename);
+  for (i = 0; i < (gint) prefetch_files->len; i++)
+    {
+      if (strcmp (base, g_ptr_array_index (prefetch_files, i)) == 0)
+        {
+          idx = i;
+          break;
+        }
+    }
+  g_free (base);
+
+  for (d = 1; idx >= 0 && d <= PREVIEW_PREFETCH; d++)
+    {
+      gint n[2] = { idx + d, idx - d };
+
+      for (i = 0; i < 2; i++)
+        {
+          gchar *path, *uri;
+          GdkPixbuf *pb;
+
+          if (gen != g_atomic_int_get (&preview_gen))
             {
-              /* try to create it */
-              g_free (file);
-              file = g_filename_from_uri (uri, NULL, NULL);
-              pb = gdk_pixbuf_new_from_file_at_size (file, 256, 256, NULL);
-              g_free (file);
+              g_free (dir);
+              return;
+            }
+          if (n[i] < 0 || n[i] >= (gint) prefetch_files->len)
+            continue;
+
+          path = g_build_filename (dir, g_ptr_array_index (prefetch_files, n[i]), NULL);
+          uri = g_filename_to_uri (path, NULL, NULL);
+          if (uri)
+            {
+              pb = get_thumbnail (uri, path, gen);
               if (pb)
-                {
-                  /* save thumbnail */
-                  g_mkdir_with_parents (large_path, 0755);
-                  file = g_strdup_printf ("%s/%s.png", large_path, g_checksum_get_string (chs));
-                  gdk_pixbuf_save (pb, file, "png", NULL, NULL);
-                }
+                g_object_unref (pb);
+              g_free (uri);
             }
+          g_free (path);
         }
-      g_checksum_free (chs);
+    }
 
-      if (pb)
+  g_free (dir);
+}
+
+static gboolean
+preview_deliver (PreviewJob * job)
+{
+  /* show only the last requested preview */
+  if (job->gen == g_atomic_int_get (&preview_gen))
+    {
+      if (job->pixbuf)
         {
-          gtk_image_set_from_pixbuf (GTK_IMAGE (p), pb);
-          g_object_unref (pb);
-          gtk_file_chooser_set_preview_widget_active (chooser, TRUE);
+          gtk_image_set_from_pixbuf (GTK_IMAGE (job->image), job->pixbuf);
+          gtk_file_chooser_set_preview_widget_active (job->chooser, TRUE);
         }
       else
-        gtk_file_chooser_set_preview_widget_active (chooser, FALSE);
+        gtk_file_chooser_set_preview_widget_active (job->chooser, FALSE);
+    }
+
+  g_free (job->uri);
+  if (job->pixbuf)
+    g_object_unref (job->pixbuf);
+  g_object_unref (job->chooser);
+  g_object_unref (job->image);
+  g_free (job);
+
+  return FALSE;
+}
+
+static void
+preview_worker (PreviewJob * job, gpointer data)
+{
+  gchar *filename = NULL;
+  gint gen = job->gen;
 
-      g_free (uri);
+  /* skip superseded requests */
+  if (gen == g_atomic_int_get (&preview_gen))
+    {
+      filename = g_filename_from_uri (job->uri, NULL, NULL);
+      if (filename)
+        job->pixbuf = get_thumbnail (job->uri, filename, gen);
     }
-  else
-    gtk_file_chooser_set_preview_widget_active (chooser, FALSE);
+  g_idle_add ((GSourceFunc) preview_deliver, job);
+
+  if (filename)
+    {
+      prefetch_neighbours (filename, gen);
+      g_free (filename);
+    }
+}
+
+void
+update_preview (GtkFileChooser * chooser, GtkWidget *p)
+{
+  PreviewJob *job;
+  gchar *uri;
+
+  if (preview_pool == NULL)
+    {
+      /* init thumbnails path */
+      thumb_normal_path = g_build_filename (g_get_user_cache_dir (), "thumbnails", "normal", NULL);
+      thumb_large_path = g_build_filename (g_get_user_cache_dir (), "thumbnails", "large", NULL);
+      /* single thread, so the last request is handled as soon as possible */
+      preview_pool = g_thread_pool_new ((GFunc) preview_worker, NULL, 1, FALSE, NULL);
+    }
+
+  /* cancel previous requests */
+  g_atomic_int_inc (&preview_gen);
+
+  uri = gtk_file_chooser_get_preview_uri (chooser);
+  if (uri == NULL)
+    {
+      gtk_file_chooser_set_preview_widget_active (chooser, FALSE);
+      return;
+    }
+
+  job = g_new0 (PreviewJob, 1);
+  job->gen = g_atomic_int_get (&preview_gen);
+  job->uri = uri;
+  job->chooser = g_object_ref (chooser);
+  job->image = g_object_ref (p);
+  g_thread_pool_push (preview_pool, job, NULL);
 }
 
 void
@@ -368,6 +791,7 @@ GtkWidget *
 get_label (gchar * str, guint border)
 {
   GtkWidget *a, *t, *i, *l;
+  GdkPixbuf *pb;
   GtkStockItem it;
   gchar **vals;
 
@@ -392,7 +816,10 @@ get_label (gchar * str, guint border)
       l = gtk_label_new_with_mnemonic (it.label);
       gtk_misc_set_alignment (GTK_MISC (l), 0.0, 0.5);
 
-      i = gtk_image_new_from_pixbuf (get_pixbuf (it.stock_id, YAD_SMALL_ICON));
+      pb = get_icon_pixbuf (it.stock_id, YAD_SMALL_ICON);
+      i = gtk_image_new_from_pixbuf (pb);
+      if (pb)
+        g_object_unref (pb);
     }
   else
     {
@@ -407,7 +834,12 @@ get_label (gchar * str, guint border)
         }
 
       if (vals[1] && *vals[1])
-        i = gtk_image_new_from_pixbuf (get_pixbuf (vals[1], YAD_SMALL_ICON));
+        {
+          pb = get_icon_pixbuf (vals[1], YAD_SMALL_ICON);
+          i = gtk_image_new_from_pixbuf (pb);
+          if (pb)
+            g_object_unref (pb);
+        }
     }
 
   if (i)
@@ -502,63 +934,845 @@ escape_char (gchar *str, gchar ch)
   return res;
 }
 
+/* same as g_utf8_validate() with explicit length, but skips ascii text
+ * by 16 (or 8) bytes at once. runs of non-ascii characters are passed to g_utf8_validate() */
 gboolean
-check_complete (GtkEntryCompletion *c, const gchar *key, GtkTreeIter *iter, gpointer data)
+validate_utf8 (const gchar *str, gsize len, const gchar **end)
 {
-  gchar *value = NULL;
-  GtkTreeModel *model = gtk_entry_completion_get_model (c);
-  gboolean found = FALSE;
+  const guchar *p = (const guchar *) str;
+  const guchar *e = p + len;
 
-  if (!model || !key || !key[0])
-    return FALSE;
+  while (p < e)
+    {
+#ifdef __SSE2__
+      const __m128i zero = _mm_setzero_si128 ();
 
-  gtk_tree_model_get (model, iter, 0, &value, -1);
+      while (e - p >= 16)
+        {
+          __m128i v = _mm_loadu_si128 ((const __m128i *) p);
 
-  if (value)
-    {
-      gchar **words = NULL;
-      guint i = 0;
+          /* stop on high bit or nul byte */
+          if (_mm_movemask_epi8 (v) | _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, zero)))
+            break;
+          p += 16;
+        }
+#endif
+      while (e - p >= 8)
+        {
+          guint64 w;
 
-      switch (options.common_data.complete)
+          memcpy (&w, p, 8);
+          if ((w | ((w - G_GUINT64_CONSTANT (0x0101010101010101)) & ~w)) & G_GUINT64_CONSTANT (0x8080808080808080))
+            break;
+          p += 8;
+        }
+
+      while (p < e && *p < 0x80)
+        {
+          if (*p == '\0')
+            goto invalid;
+          p++;
+        }
+
+      if (p < e)
         {
-        case YAD_COMPLETE_ANY:
-          words = g_strsplit_set (key, " \t", -1);
-          while (words[i])
+          const guchar *run = p;
+          const gchar *stop;
+
+          /* run of non-ascii bytes ends on ascii byte, which is always a character boundary
+           * in valid text. so the whole run is checked by one call */
+          while (p < e && *p >= 0x80)
+            p++;
+          if (!g_utf8_validate ((const gchar *) run, p - run, &stop))
             {
-              if (strcasestr (value, words[i]) != NULL)
-                {
-                  /* found one of the words */
-                  found = TRUE;
-                  break;
-                }
-              i++;
+              p = (const guchar *) stop;
+              goto invalid;
             }
+        }
+    }
+
+  if (end)
+    *end = (const gchar *) e;
+  return TRUE;
+
+invalid:
+  if (end)
+    *end = (const gchar *) p;
+  return FALSE;
+}
+
+#ifdef HAVE_GIO
+#ifdef HAVE_ZSTD
+/* GConverter implementation for zstd decompression */
+typedef struct {
+  GObject parent;
+  ZSTD_DStream *ds;
+  gboolean frame_done;
+} YadZstdDecompressor;
+
+typedef struct {
+  GObjectClass parent_class;
+} YadZstdDecompressorClass;
+
+static void yad_zstd_decompressor_iface_init (GConverterIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (YadZstdDecompressor, yad_zstd_decompressor, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_CONVERTER, yad_zstd_decompressor_iface_init))
+
+static void
+yad_zstd_decompressor_finalize (GObject *obj)
+{
+  YadZstdDecompressor *d = (YadZstdDecompressor *) obj;
+
+  ZSTD_freeDStream (d->ds);
+  G_OBJECT_CLASS (yad_zstd_decompressor_parent_class)->finalize (obj);
+}
+
+static void
+yad_zstd_decompressor_init (YadZstdDecompressor *d)
+{
+  d->ds = ZSTD_createDStream ();
+  ZSTD_initDStream (d->ds);
+  d->frame_done = FALSE;
+}
+
+static void
+yad_zstd_decompressor_class_init (YadZstdDecompressorClass *klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = yad_zstd_decompressor_finalize;
+}
+
+static GConverterResult
+yad_zstd_decompressor_convert (GConverter *conv, const void *inbuf, gsize inbuf_size,
+                               void *outbuf, gsize outbuf_size, GConverterFlags flags,
+                               gsize *bytes_read, gsize *bytes_written, GError **err)
+{
+  YadZstdDecompressor *d = (YadZstdDecompressor *) conv;
+  ZSTD_inBuffer in = { inbuf, inbuf_size, 0 };
+  ZSTD_outBuffer out = { outbuf, outbuf_size, 0 };
+  gsize ret;
+
+  ret = ZSTD_decompressStream (d->ds, &out, &in);
+  if (ZSTD_isError (ret))
+    {
+      g_set_error (err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "%s", ZSTD_getErrorName (ret));
+      return G_CONVERTER_ERROR;
+    }
+
+  *bytes_read = in.pos;
+  *bytes_written = out.pos;
+
+  /* file may contain several frames */
+  if (ret == 0)
+    d->frame_done = TRUE;
+  else if (in.pos > 0 || out.pos > 0)
+    d->frame_done = FALSE;
+
+  if ((flags & G_CONVERTER_INPUT_AT_END) && in.pos == inbuf_size && d->frame_done)
+    return G_CONVERTER_FINISHED;
+
+  if (in.pos == 0 && out.pos == 0)
+    {
+      if (flags & G_CONVERTER_INPUT_AT_END)
+        g_set_error_literal (err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Unexpected end of zstd data");
+      else
+        g_set_error_literal (err, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT, "Need more input");
+      return G_CONVERTER_ERROR;
+    }
+
+  return G_CONVERTER_CONVERTED;
+}
+
+static void
+yad_zstd_decompressor_reset (GConverter *conv)
+{
+  YadZstdDecompressor *d = (YadZstdDecompressor *) conv;
+
+  ZSTD_initDStream (d->ds);
+  d->frame_done = FALSE;
+}
+
+static void
+yad_zstd_decompressor_iface_init (GConverterIface *iface)
+{
+  iface->convert = yad_zstd_decompressor_convert;
+  iface->reset = yad_zstd_decompressor_reset;
+}
+#endif
+
+/* returns stream with unpacked data if file is compressed (detected by magic bytes)
+ * or NULL for all other files. Only regular files are checked, because magic bytes
+ * can't be put back into pipes and reading them may block */
+GInputStream *
+open_compressed_file (const gchar *filename)
+{
+  GFile *file;
+  GInputStream *in, *res = NULL;
+  GConverter *conv = NULL;
+  struct stat st;
+  guchar magic[4];
+  gsize n = 0;
+
+  if (stat (filename, &st) != 0 || !S_ISREG (st.st_mode))
+    return NULL;
+
+  file = g_file_new_for_path (filename);
+  in = (GInputStream *) g_file_read (file, NULL, NULL);
+  g_object_unref (file);
+  if (in == NULL)
+    return NULL;
+
+  g_input_stream_read_all (in, magic, sizeof (magic), &n, NULL, NULL);
+  if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+    conv = (GConverter *) g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP);
+#ifdef HAVE_ZSTD
+  else if (n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+    conv = (GConverter *) g_object_new (yad_zstd_decompressor_get_type (), NULL);
+#endif
+
+  if (conv)
+    {
+      if (g_seekable_seek (G_SEEKABLE (in), 0, G_SEEK_SET, NULL, NULL))
+        res = g_converter_input_stream_new (in, conv);
+      g_object_unref (conv);
+    }
+  g_object_unref (in);
+
+  return res;
+}
+#endif
+
+/* calls func for every complete line in buf and removes processed lines from it.
+ * Incomplete last line is kept for the next call if eof is not set.
+ * Returns FALSE if func has stopped processing */
+gboolean
+process_lines (GString * buf, gboolean eof, YadLineFunc func, gpointer data)
+{
+  gchar *line, *nl;
+  gboolean res = TRUE;
+
+  if (buf->len == 0)
+    return TRUE;
+
+  line = buf->str;
+  while (res && (nl = memchr (line, '\n', buf->len - (line - buf->str))) != NULL)
+    {
+      *nl = '\0';
+      res = func (line, data);
+      line = nl + 1;
+    }
+  if (res && eof && *line)
+    {
+      res = func (line, data);
+      line = buf->str + buf->len;
+    }
+  g_string_erase (buf, 0, line - buf->str);
+
+  return res;
+}
+
+#define SOCKET_READ_SIZE 4096
+#define SOCKET_MAX_READS 64
+
+typedef struct {
+  YadLineFunc line_func;
+  YadBatchFunc batch_func;
+  gpointer data;
+} YadSocket;
+
+typedef struct {
+  YadSocket *sock;
+  GString *buf;
+} YadSocketClient;
+
+static GSList *socket_paths = NULL;
+
+static void
+remove_sockets (void)
+{
+  GSList *p;
+
+  for (p = socket_paths; p; p = p->next)
+    unlink ((gchar *) p->data);
+}
+
+static gboolean
+socket_client_cb (GIOChannel * ch, GIOCondition cond, gpointer d)
+{
+  YadSocketClient *cl = (YadSocketClient *) d;
+  gchar buf[SOCKET_READ_SIZE];
+  gboolean eof = FALSE, res;
+  gint n;
+
+  /* read all available data from this client */
+  for (n = 0; n < SOCKET_MAX_READS; n++)
+    {
+      GIOStatus status;
+      gsize len = 0;
+
+      status = g_io_channel_read_chars (ch, buf, SOCKET_READ_SIZE, &len, NULL);
+      if (len > 0)
+        g_string_append_len (cl->buf, buf, len);
+
+      if (status == G_IO_STATUS_AGAIN)
+        break;
+      if (status != G_IO_STATUS_NORMAL)
+        {
+          eof = TRUE;
           break;
-        case YAD_COMPLETE_ALL:
-          words = g_strsplit_set (key, " \t", -1);
-          found = TRUE;
-          while (words[i])
+        }
+    }
+  if ((cond & G_IO_HUP) && !(cond & G_IO_IN))
+    eof = TRUE;
+
+  res = process_lines (cl->buf, eof, cl->sock->line_func, cl->sock->data);
+  if (cl->sock->batch_func)
+    cl->sock->batch_func (!res, cl->sock->data);
+
+  if (eof)
+    {
+      /* client is gone, other ones still works */
+      g_io_channel_shutdown (ch, FALSE, NULL);
+      g_io_channel_unref (ch);
+      g_string_free (cl->buf, TRUE);
+      g_free (cl);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+socket_accept_cb (GIOChannel * ch, GIOCondition cond, gpointer d)
+{
+  gint fd;
+
+  while ((fd = accept (g_io_channel_unix_get_fd (ch), NULL, NULL)) >= 0)
+    {
+      YadSocketClient *cl;
+      GIOChannel *cch;
+
+      cl = g_new0 (YadSocketClient, 1);
+      cl->sock = (YadSocket *) d;
+      cl->buf = g_string_new (NULL);
+
+      cch = g_io_channel_unix_new (fd);
+      g_io_channel_set_encoding (cch, NULL, NULL);
+      g_io_channel_set_flags (cch, G_IO_FLAG_NONBLOCK, NULL);
+      g_io_channel_set_close_on_unref (cch, TRUE);
+      g_io_add_watch (cch, G_IO_IN | G_IO_HUP | G_IO_ERR, socket_client_cb, cl);
+    }
+
+  if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    g_printerr ("yad: accept(): %s\n", g_strerror (errno));
+
+  return TRUE;
+}
+
+/* creates unix socket which accepts any number of clients.
+ * line_func is called for every line from any client, batch_func - after each portion of data */
+gboolean
+listen_socket (const gchar * path, YadLineFunc line_func, YadBatchFunc batch_func, gpointer data)
+{
+  YadSocket *sock;
+  GIOChannel *ch;
+  struct sockaddr_un addr;
+  struct stat st;
+  gint fd;
+
+  if (strlen (path) >= sizeof (addr.sun_path))
+    {
+      g_printerr (_("Socket path is too long: %s\n"), path);
+      return FALSE;
+    }
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, path);
+
+  fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    {
+      g_printerr (_("Cannot create socket: %s\n"), g_strerror (errno));
+      return FALSE;
+    }
+
+  if (stat (path, &st) == 0 && S_ISSOCK (st.st_mode))
+    {
+      /* don't steal socket from running dialog, remove only stale one */
+      gint probe = socket (AF_UNIX, SOCK_STREAM, 0);
+
+      if (probe >= 0 && connect (probe, (struct sockaddr *) &addr, sizeof (addr)) == 0)
+        {
+          g_printerr (_("Socket %s is already in use\n"), path);
+          close (probe);
+          close (fd);
+          return FALSE;
+        }
+      if (probe >= 0)
+        close (probe);
+      unlink (path);
+    }
+
+  if (bind (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0 || listen (fd, SOMAXCONN) < 0)
+    {
+      g_printerr (_("Cannot listen socket %s: %s\n"), path, g_strerror (errno));
+      close (fd);
+      return FALSE;
+    }
+  fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+
+  if (socket_paths == NULL)
+    atexit (remove_sockets);
+  socket_paths = g_slist_prepend (socket_paths, g_strdup (path));
+
+  sock = g_new0 (YadSocket, 1);
+  sock->line_func = line_func;
+  sock->batch_func = batch_func;
+  sock->data = data;
+
+  ch = g_io_channel_unix_new (fd);
+  g_io_add_watch (ch, G_IO_IN, socket_accept_cb, sock);
+
+  return TRUE;
+}
+
+static GSList *shm_names = NULL;
+
+static void
+remove_shm (void)
+{
+  GSList *p;
+
+  for (p = shm_names; p; p = p->next)
+    shm_unlink ((gchar *) p->data);
+}
+
+/* maps array of n progress counters. name in form /NAME means POSIX shared memory object,
+ * all other names are regular files. Object is created if it doesn't exist */
+YadShmCounter *
+open_shm_counters (const gchar * name, guint n)
+{
+  YadShmCounter *cnt;
+  struct stat st;
+  gsize size = n * sizeof (YadShmCounter);
+  gboolean is_shm, created = FALSE;
+  gint fd;
+
+  is_shm = (name[0] == '/' && strchr (name + 1, '/') == NULL);
+
+  if (is_shm)
+    {
+      fd = shm_open (name, O_RDWR | O_CREAT | O_EXCL, 0600);
+      if (fd >= 0)
+        created = TRUE;
+      else if (errno == EEXIST)
+        fd = shm_open (name, O_RDWR, 0600);
+    }
+  else
+    fd = open (name, O_RDWR | O_CREAT, 0600);
+
+  if (fd < 0)
+    {
+      g_printerr (_("Cannot open shared memory %s: %s\n"), name, g_strerror (errno));
+      return NULL;
+    }
+
+  /* new space is filled with zeroes */
+  if (fstat (fd, &st) == 0 && (gsize) st.st_size < size)
+    {
+      if (ftruncate (fd, size) < 0)
+        {
+          g_printerr (_("Cannot open shared memory %s: %s\n"), name, g_strerror (errno));
+          close (fd);
+          return NULL;
+        }
+    }
+
+  cnt = mmap (NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (cnt == MAP_FAILED)
+    {
+      g_printerr (_("Cannot open shared memory %s: %s\n"), name, g_strerror (errno));
+      return NULL;
+    }
+
+  if (created)
+    {
+      if (shm_names == NULL)
+        atexit (remove_shm);
+      shm_names = g_slist_prepend (shm_names, g_strdup (name));
+    }
+
+  return cnt;
+}
+
+/* completion uses index of candidates and shows only limited number of matches */
+#define COMPLETE_MAX_MATCHES 256
+#define TRIGRAM(s) GUINT_TO_POINTER (((guint8) (s)[0] << 16) | ((guint8) (s)[1] << 8) | (guint8) (s)[2])
+
+typedef struct {
+  GPtrArray *items;             /* original strings */
+  GPtrArray *folded;            /* casefolded strings */
+  GHashTable *trigrams;         /* trigram -> GArray of item indexes */
+  GtkListStore *store;          /* shown matches */
+  gchar *last_key;
+  GArray *last_matches;         /* all matches of the last search */
+} YadCompletion;
+
+static gchar *
+fold_string (const gchar * str)
+{
+  gchar *norm, *res;
+
+  norm = g_utf8_normalize (str, -1, G_NORMALIZE_ALL);
+  if (norm == NULL)
+    return g_ascii_strdown (str, -1);
+
+  res = g_utf8_casefold (norm, -1);
+  g_free (norm);
+
+  return res;
+}
+
+static void
+free_completion_index (YadCompletion * cmp)
+{
+  if (cmp->items)
+    g_ptr_array_free (cmp->items, TRUE);
+  if (cmp->folded)
+    g_ptr_array_free (cmp->folded, TRUE);
+  if (cmp->trigrams)
+    g_hash_table_destroy (cmp->trigrams);
+  if (cmp->last_matches)
+    g_array_free (cmp->last_matches, TRUE);
+  g_free (cmp->last_key);
+
+  cmp->items = cmp->folded = NULL;
+  cmp->trigrams = NULL;
+  cmp->last_matches = NULL;
+  cmp->last_key = NULL;
+}
+
+static void
+free_completion (YadCompletion * cmp)
+{
+  free_completion_index (cmp);
+  g_object_unref (cmp->store);
+  g_free (cmp);
+}
+
+static void
+free_trigram_list (GArray * a)
+{
+  g_array_free (a, TRUE);
+}
+
+/* returns indexes of items which contains all trigrams of the word (most of the times).
+ * NULL means that the word is too short for index */
+static GArray *
+word_candidates (YadCompletion * cmp, const gchar * word)
+{
+  GArray *best = NULL;
+  gsize i, len = strlen (word);
+
+  if (len < 3)
+    return NULL;
+
+  for (i = 0; i + 3 <= len; i++)
+    {
+      GArray *a = g_hash_table_lookup (cmp->trigrams, TRIGRAM (word + i));
+
+      if (a == NULL)
+        return g_array_new (FALSE, FALSE, sizeof (guint));
+      if (best == NULL || a->len < best->len)
+        best = a;
+    }
+
+  /* shortest list is enough, all items are checked anyway */
+  best = g_array_append_vals (g_array_sized_new (FALSE, FALSE, sizeof (guint), best->len), best->data, best->len);
+  return best;
+}
+
+static gint
+compare_indexes (gconstpointer a, gconstpointer b)
+{
+  guint x = *(const guint *) a, y = *(const guint *) b;
+
+  return (x > y) - (x < y);
+}
+
+static gboolean
+match_item (const gchar * value, gchar ** words)
+{
+  guint i;
+
+  switch (options.common_data.complete)
+    {
+    case YAD_COMPLETE_ANY:
+      for (i = 0; words[i]; i++)
+        {
+          /* found one of the words */
+          if (strstr (value, words[i]) != NULL)
+            return TRUE;
+        }
+      return FALSE;
+    case YAD_COMPLETE_ALL:
+      for (i = 0; words[i]; i++)
+        {
+          /* not found one of the words */
+          if (strstr (value, words[i]) == NULL)
+            return FALSE;
+        }
+      return TRUE;
+    default:
+      return g_str_has_prefix (value, words[0]);
+    }
+}
+
+static GArray *
+search_words (YadCompletion * cmp, const gchar * key)
+{
+  GArray *base = NULL, *res;
+  gchar **words;
+  gboolean narrow;
+  guint i, n, max;
+
+  /* prepare the key once */
+  if (options.common_data.complete == YAD_COMPLETE_SIMPLE)
+    {
+      words = g_new0 (gchar *, 2);
+      words[0] = g_strdup (key);
+    }
+  else
+    {
+      gchar **w = g_strsplit_set (key, " \t", -1);
+
+      /* remove empty words */
+      for (i = n = 0; w[i]; i++)
+        {
+          if (w[i][0])
+            w[n++] = w[i];
+          else
+            g_free (w[i]);
+        }
+      w[n] = NULL;
+      words = w;
+    }
+
+  if (words[0] == NULL)
+    {
+      g_strfreev (words);
+      return g_array_new (FALSE, FALSE, sizeof (guint));
+    }
+
+  /* longer key can only reduce the previous matches, except in any-word mode */
+  narrow = (options.common_data.complete != YAD_COMPLETE_ANY &&
+            cmp->last_matches && cmp->last_key && g_str_has_prefix (key, cmp->last_key));
+
+  if (narrow)
+    base = g_array_append_vals (g_array_new (FALSE, FALSE, sizeof (guint)),
+                                cmp->last_matches->data, cmp->last_matches->len);
+  else if (options.common_data.complete == YAD_COMPLETE_ANY)
+    {
+      /* union of candidates of all words */
+      base = g_array_new (FALSE, FALSE, sizeof (guint));
+      for (i = 0; words[i]; i++)
+        {
+          GArray *c = word_candidates (cmp, words[i]);
+
+          if (c == NULL)
             {
-              if (strcasestr (value, words[i]) == NULL)
-                {
-                  /* not found one of the words */
-                  found = FALSE;
-                  break;
-                }
-              i++;
+              /* check all items */
+              g_array_free (base, TRUE);
+              base = NULL;
+              break;
             }
-          break;
-        case YAD_COMPLETE_REGEX:
-          found = g_regex_match_simple (key, value, G_REGEX_CASELESS | G_REGEX_OPTIMIZE, G_REGEX_MATCH_NOTEMPTY);
-          break;
-        default: ;
+          g_array_append_vals (base, c->data, c->len);
+          g_array_free (c, TRUE);
+        }
+      if (base)
+        {
+          g_array_sort (base, compare_indexes);
+          for (i = n = 0; i < base->len; i++)
+            {
+              if (n == 0 || g_array_index (base, guint, i) != g_array_index (base, guint, n - 1))
+                g_array_index (base, guint, n++) = g_array_index (base, guint, i);
+            }
+          g_array_set_size (base, n);
+        }
+    }
+  else
+    {
+      /* the rarest word gives the smallest set */
+      for (i = 0; words[i]; i++)
+        {
+          GArray *c = word_candidates (cmp, words[i]);
+
+          if (c && (base == NULL || c->len < base->len))
+            {
+              if (base)
+                g_array_free (base, TRUE);
+              base = c;
+            }
+          else if (c)
+            g_array_free (c, TRUE);
         }
+    }
+
+  /* all matches are needed only for narrowing later */
+  max = (options.common_data.complete == YAD_COMPLETE_ANY) ? COMPLETE_MAX_MATCHES : G_MAXUINT;
 
-      if (words)
-        g_strfreev (words);
+  res = g_array_new (FALSE, FALSE, sizeof (guint));
+  n = base ? base->len : cmp->folded->len;
+  for (i = 0; i < n && res->len < max; i++)
+    {
+      guint idx = base ? g_array_index (base, guint, i) : i;
+
+      if (match_item (g_ptr_array_index (cmp->folded, idx), words))
+        g_array_append_val (res, idx);
     }
 
-  return found;
+  if (base)
+    g_array_free (base, TRUE);
+  g_strfreev (words);
+
+  return res;
+}
+
+static GArray *
+search_regex (YadCompletion * cmp, const gchar * text)
+{
+  GRegex *re;
+  GArray *res;
+  guint i;
+
+  res = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  /* compile pattern once for all items */
+  re = g_regex_new (text, G_REGEX_CASELESS | G_REGEX_OPTIMIZE, G_REGEX_MATCH_NOTEMPTY, NULL);
+  if (re == NULL)
+    return res;
+
+  for (i = 0; i < cmp->items->len && res->len < COMPLETE_MAX_MATCHES; i++)
+    {
+      if (g_regex_match (re, g_ptr_array_index (cmp->items, i), 0, NULL))
+        g_array_append_val (res, i);
+    }
+  g_regex_unref (re);
+
+  return res;
+}
+
+static void
+completion_changed_cb (GtkEditable * entry, YadCompletion * cmp)
+{
+  const gchar *text = gtk_entry_get_text (GTK_ENTRY (entry));
+  GArray *res = NULL;
+  guint i;
+
+  gtk_list_store_clear (cmp->store);
+
+  if (cmp->items && text && text[0])
+    {
+      gchar *key = fold_string (text);
+
+      if (options.common_data.complete == YAD_COMPLETE_REGEX)
+        res = search_regex (cmp, text);
+      else
+        res = search_words (cmp, key);
+
+      for (i = 0; i < res->len && i < COMPLETE_MAX_MATCHES; i++)
+        {
+          GtkTreeIter it;
+
+          gtk_list_store_append (cmp->store, &it);
+          gtk_list_store_set (cmp->store, &it, 0, g_ptr_array_index (cmp->items, g_array_index (res, guint, i)), -1);
+        }
+
+      g_free (cmp->last_key);
+      cmp->last_key = key;
+    }
+  else
+    {
+      g_free (cmp->last_key);
+      cmp->last_key = NULL;
+    }
+
+  if (cmp->last_matches)
+    g_array_free (cmp->last_matches, TRUE);
+  cmp->last_matches = res;
+}
+
+static gboolean
+match_all (GtkEntryCompletion * c, const gchar * key, GtkTreeIter * iter, gpointer data)
+{
+  /* completion model contains matches only */
+  return TRUE;
+}
+
+void
+init_completion (GtkWidget * entry)
+{
+  GtkEntryCompletion *c;
+  YadCompletion *cmp;
+
+  cmp = g_new0 (YadCompletion, 1);
+  cmp->store = gtk_list_store_new (1, G_TYPE_STRING);
+  g_object_set_data_full (G_OBJECT (entry), "yad-completion", cmp, (GDestroyNotify) free_completion);
+
+  /* matches must be ready before completion handles the change */
+  g_signal_connect (G_OBJECT (entry), "changed", G_CALLBACK (completion_changed_cb), cmp);
+
+  c = gtk_entry_completion_new ();
+  gtk_entry_set_completion (GTK_ENTRY (entry), c);
+  gtk_entry_completion_set_model (c, GTK_TREE_MODEL (cmp->store));
+  gtk_entry_completion_set_text_column (c, 0);
+  gtk_entry_completion_set_match_func (c, match_all, NULL, NULL);
+  g_object_unref (c);
+}
+
+/* build index of completion candidates */
+void
+set_completion_items (GtkWidget * entry, gchar ** items)
+{
+  YadCompletion *cmp;
+  guint i;
+
+  cmp = g_object_get_data (G_OBJECT (entry), "yad-completion");
+  if (cmp == NULL)
+    return;
+
+  free_completion_index (cmp);
+  gtk_list_store_clear (cmp->store);
+
+  cmp->items = g_ptr_array_new_with_free_func (g_free);
+  cmp->folded = g_ptr_array_new_with_free_func (g_free);
+  cmp->trigrams = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) free_trigram_list);
+
+  for (i = 0; items && items[i]; i++)
+    {
+      gchar *f = fold_string (items[i]);
+      gsize j, len = strlen (f);
+
+      g_ptr_array_add (cmp->items, g_strdup (items[i]));
+      g_ptr_array_add (cmp->folded, f);
+
+      for (j = 0; j + 3 <= len; j++)
+        {
+          gpointer tg = TRIGRAM (f + j);
+          GArray *a = g_hash_table_lookup (cmp->trigrams, tg);
+
+          if (a == NULL)
+            {
+              a = g_array_new (FALSE, FALSE, sizeof (guint));
+              g_hash_table_insert (cmp->trigrams, tg, a);
+            }
+          /* item index is added once */
+          if (a->len == 0 || g_array_index (a, guint, a->len - 1) != i)
+            g_array_append_val (a, i);
+        }
+    }
 }
 
 #ifdef HAVE_SPELL
@@ -187,6 +187,12 @@ typedef struct {
   YadProgressType type;
 } YadProgressBar;
 
+/* progress counter in shared memory, updated by external process */
+typedef struct {
+  guint64 done;
+  guint64 total;
+} YadShmCounter;
+
 typedef struct {
   gchar *name;
   gint value;
@@ -301,7 +307,6 @@ typedef struct {
   gboolean browser;
   gboolean print_uri;
   gchar *mime;
-  gchar *encoding;
   gchar *uri_cmd;
   gchar *user_agent;
   gchar *user_style;
@@ -315,6 +320,7 @@ typedef struct {
   gboolean descend;
   gboolean sort_by_name;
   gboolean single_click;
+  gboolean grid;
   guint width;
   gchar *term;
 #ifdef HAVE_GIO
@@ -398,6 +404,15 @@ typedef struct {
   gboolean log_expanded;
   gboolean log_on_top;
   gint log_height;
+  gint log_lines;
+  gchar *log_file;
+  gchar *eta;
+  gchar *shm;
+  gboolean pipe;
+  gint64 size;
+  gchar *watch_file;
+  gint watch_pid;
+  gboolean watch_write;
 } YadProgressData;
 
 typedef struct {
@@ -407,6 +422,7 @@ typedef struct {
   gint step;
   gint page;
   gboolean print_partial;
+  gint partial_interval;
   gboolean hide_value;
   gboolean have_value;
   gboolean invert;
@@ -423,6 +439,13 @@ typedef struct {
   gboolean uri;
   gboolean hide_cursor;
   gchar *uri_color;
+  gboolean replace_invalid;
+  gboolean ansi;
+  gint max_line;
+  gboolean truncate_lines;
+#ifdef HAVE_GIO
+  gboolean follow;
+#endif
 } YadTextData;
 
 #ifdef HAVE_SOURCEVIEW
@@ -446,10 +469,12 @@ typedef struct {
   guint float_precision;
   gdouble align;
   gboolean listen;
+  gchar *socket;
   gboolean preview;
   gboolean show_hidden;
   gboolean quoted_output;
   gboolean num_output;
+  gchar *encoding;
 #if GLIB_CHECK_VERSION(2,30,0)
   GFormatSizeFlags size_fmt;
 #endif
@@ -587,6 +612,7 @@ void list_print_result (void);
 void notebook_print_result (void);
 void paned_print_result (void);
 void scale_print_result (void);
+void scale_flush_partial (void);
 void text_print_result (void);
 
 void dnd_init (GtkWidget *w);
@@ -607,6 +633,7 @@ void update_preview (GtkFileChooser *chooser, GtkWidget *p);
 void filechooser_mapped (GtkWidget *w, gpointer data);
 
 GdkPixbuf *get_pixbuf (gchar *name, YadIconSize size);
+GdkPixbuf *get_icon_pixbuf (gchar *name, YadIconSize size);
 gchar *get_color (GdkColor *c, guint64 alpha);
 
 gchar **split_arg (const gchar *str);
@@ -618,11 +645,49 @@ GtkWidget *get_label (gchar *str, guint border);
 gchar *escape_str (gchar *str);
 gchar *escape_char (gchar *str, gchar ch);
 
-gboolean check_complete (GtkEntryCompletion *c, const gchar *key, GtkTreeIter *iter, gpointer data);
+gboolean validate_utf8 (const gchar *str, gsize len, const gchar **end);
+
+typedef gboolean (*YadLineFunc) (gchar *line, gpointer data);
+typedef void (*YadBatchFunc) (gboolean stopped, gpointer data);
+
+gboolean process_lines (GString *buf, gboolean eof, YadLineFunc func, gpointer data);
+gboolean listen_socket (const gchar *path, YadLineFunc line_func, YadBatchFunc batch_func, gpointer data);
+
+YadShmCounter *open_shm_counters (const gchar *name, guint n);
+#ifdef HAVE_GIO
+GInputStream *open_compressed_file (const gchar *filename);
+#endif
+
+void init_completion (GtkWidget *entry);
+void set_completion_items (GtkWidget *entry, gchar **items);
 
 void show_langs ();
 void show_themes ();
 
+static inline void
+read_shm_counter (YadShmCounter * cnt, guint64 * done, guint64 * total)
+{
+#ifdef __ATOMIC_RELAXED
+  *total = __atomic_load_n (&cnt->total, __ATOMIC_RELAXED);
+  *done = __atomic_load_n (&cnt->done, __ATOMIC_RELAXED);
+#else
+  *total = ((volatile YadShmCounter *) cnt)->total;
+  *done = ((volatile YadShmCounter *) cnt)->done;
+#endif
+}
+
+static inline void
+write_shm_counter (YadShmCounter * cnt, guint64 done, guint64 total)
+{
+#ifdef __ATOMIC_RELAXED
+  __atomic_store_n (&cnt->total, total, __ATOMIC_RELAXED);
+  __atomic_store_n (&cnt->done, done, __ATOMIC_RELAXED);
+#else
+  ((volatile YadShmCounter *) cnt)->total = total;
+  ((volatile YadShmCounter *) cnt)->done = done;
+#endif
+}
+
 static inline void
 strip_new_line (gchar * str)
 {